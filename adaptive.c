@@ -0,0 +1,215 @@
+// clang-format off
+#include "adaptive.h"	// Adaptive header file
+#include "io.h"			// IO header file
+#include "defines.h"	// Defines header file
+
+#include <stdint.h>		// Declares more integer types
+#include <stdlib.h>		// Used for macros and functions used in our program
+// clang-format on
+
+// An Adaptive tree is the Huffman tree of every symbol coded so far, updated
+// after each symbol with the FGK algorithm, so the encoder and decoder keep
+// identical trees without ever sending one. Symbols not seen yet are sent as
+// the code of the NYT (not yet transmitted) leaf, which has weight 0,
+// followed by the symbol in AD_BITS raw bits. AD_END, sent once at the
+// end of the stream the same way, marks where the codes stop. AD_FLUSH,
+// sent the same way whenever the encoder runs out of input for now, is
+// followed by 0 bits up to a whole byte, so every symbol before it can be
+// decoded from the bytes written so far.
+//
+// Nodes live in one array indexed by their FGK node number: weights never
+// decrease as numbers go up, the root is the last node, and siblings sit
+// next to each other with the right child above the left one. Updating the
+// tree swaps a node with the last node of the same weight before the weight
+// is bumped, which keeps that order.
+
+// Adaptive Struct
+struct Adaptive {
+  uint64_t weight[AD_NODES]; // Number of symbols coded under a node
+  uint16_t parent[AD_NODES]; // Parent of a node, NIL for the root
+  uint16_t left[AD_NODES];   // Left (0) child, NIL for a leaf
+  uint16_t right[AD_NODES];  // Right (1) child, NIL for a leaf
+  uint16_t symbol[AD_NODES]; // Symbol of a leaf
+  uint16_t leaf[ALPHABET];   // Leaf of every symbol seen, or NIL
+  uint16_t nyt;              // The NYT leaf, always the lowest node
+};
+
+// ad_create : Constructor for an Adaptive tree that has seen no symbols yet.
+// Returns NULL if error.
+Adaptive *ad_create(void) {
+  Adaptive *a = (Adaptive *)malloc(sizeof(Adaptive));
+  if (a != NULL) {
+    ad_reset(a);
+  }
+  return a;
+}
+
+// ad_reset : Function that forgets every symbol an Adaptive tree has seen
+void ad_reset(Adaptive *a) {
+  for (int i = 0; i < ALPHABET; i += 1) {
+    a->leaf[i] = NIL;
+  }
+  a->nyt = AD_NODES - 1; // The NYT leaf starts out as the root
+  a->weight[a->nyt] = 0;
+  a->parent[a->nyt] = NIL;
+  a->left[a->nyt] = NIL;
+  a->right[a->nyt] = NIL;
+  a->symbol[a->nyt] = AD_END;
+  return;
+}
+
+// ad_delete : Function that deletes an Adaptive tree
+void ad_delete(Adaptive **a) {
+  free(*a);
+  *a = NULL;
+  return;
+}
+
+// adopt : Helper function that points the children of node n, or the leaf
+// map for its symbol, back at n
+static void adopt(Adaptive *a, uint16_t n) {
+  if (a->left[n] == NIL) {
+    if (a->symbol[n] < ALPHABET) {
+      a->leaf[a->symbol[n]] = n;
+    }
+    return;
+  }
+  a->parent[a->left[n]] = n;
+  a->parent[a->right[n]] = n;
+  return;
+}
+
+// swap : Helper function that swaps the subtrees at nodes n and m, which keep
+// their places under their parents
+static void swap(Adaptive *a, uint16_t n, uint16_t m) {
+  uint64_t weight = a->weight[n];
+  uint16_t left = a->left[n];
+  uint16_t right = a->right[n];
+  uint16_t symbol = a->symbol[n];
+  a->weight[n] = a->weight[m];
+  a->left[n] = a->left[m];
+  a->right[n] = a->right[m];
+  a->symbol[n] = a->symbol[m];
+  a->weight[m] = weight;
+  a->left[m] = left;
+  a->right[m] = right;
+  a->symbol[m] = symbol;
+  adopt(a, n);
+  adopt(a, m);
+  return;
+}
+
+// update : Helper function that adds one more symbol to the tree. n is the
+// leaf of the symbol, or the NYT leaf for a symbol not seen yet.
+static void update(Adaptive *a, uint16_t n, uint16_t symbol) {
+  if (n == a->nyt) { // Split the NYT leaf into a new NYT and a new leaf
+    uint16_t nyt = n - 2;
+    uint16_t leaf = n - 1;
+    a->left[n] = nyt;
+    a->right[n] = leaf;
+    a->weight[nyt] = 0;
+    a->left[nyt] = NIL;
+    a->right[nyt] = NIL;
+    a->symbol[nyt] = AD_END;
+    a->weight[leaf] = 0;
+    a->left[leaf] = NIL;
+    a->right[leaf] = NIL;
+    a->symbol[leaf] = symbol;
+    adopt(a, n);
+    adopt(a, leaf);
+    a->nyt = nyt;
+    n = leaf;
+  }
+  while (n != NIL) { // Bump every weight on the way up to the root
+    uint16_t leader = n; // Last node with the same weight
+    while (leader + 1 < AD_NODES &&
+           a->weight[leader + 1] == a->weight[n]) {
+      leader += 1;
+    }
+    if (leader != n && leader != a->parent[n]) {
+      swap(a, n, leader);
+      n = leader;
+    }
+    a->weight[n] += 1;
+    n = a->parent[n];
+  }
+  return;
+}
+
+// ad_encode : Function that writes the code of symbol (a byte, AD_END or
+// AD_FLUSH) to a Bit Writer and adds the symbol to the tree. Returns the
+// number of bits written.
+uint32_t ad_encode(Adaptive *a, BitWriter *w, uint16_t symbol) {
+  uint16_t n = symbol < ALPHABET && a->leaf[symbol] != NIL ? a->leaf[symbol]
+                                                           : a->nyt;
+  uint8_t path[AD_NODES]; // Branches taken, from n up to the root
+  uint32_t depth = 0;
+  for (uint16_t m = n; a->parent[m] != NIL; m = a->parent[m]) {
+    path[depth] = a->right[a->parent[m]] == m;
+    depth += 1;
+  }
+  uint32_t bits = 0; // Up to 32 branches, the one nearest the root first
+  uint32_t nbits = 0;
+  for (uint32_t i = depth; i > 0; i -= 1) {
+    bits |= (uint32_t)path[i - 1] << nbits;
+    nbits += 1;
+    if (nbits == 32) {
+      bw_write_bits(w, bits, nbits);
+      bits = 0;
+      nbits = 0;
+    }
+  }
+  bw_write_bits(w, bits, nbits);
+  if (n == a->nyt) { // New symbol: spell it out after the NYT code
+    bw_write_bits(w, symbol, AD_BITS);
+    depth += AD_BITS;
+  }
+  if (symbol < ALPHABET) {
+    update(a, n, symbol);
+  }
+  return depth;
+}
+
+// ad_flush : Function that writes AD_FLUSH to a Bit Writer and pads it to a
+// whole byte, so a reader can decode every symbol written so far
+void ad_flush(Adaptive *a, BitWriter *w) {
+  ad_encode(a, w, AD_FLUSH);
+  bw_write_bits(w, 0, (8 - w->bits % 8) % 8);
+  return;
+}
+
+// ad_decode : Function that reads the next code from a Bit Reader into
+// *symbol (a byte, AD_END or AD_FLUSH) and adds the symbol to the tree.
+// After AD_FLUSH, the reader is moved on to the next whole byte. Returns the
+// number of bits read, or 0 if the reader ran out of bits or the bits do not
+// form a symbol.
+uint32_t ad_decode(Adaptive *a, BitReader *r, uint16_t *symbol) {
+  uint16_t n = AD_NODES - 1;
+  uint32_t depth = 0;
+  while (a->left[n] != NIL) { // Walk down from the root a branch at a time
+    uint32_t bit = br_peek(r, 1);
+    if (!br_skip(r, 1)) {
+      return 0;
+    }
+    n = bit ? a->right[n] : a->left[n];
+    depth += 1;
+  }
+  if (n == a->nyt) { // New symbol: it follows in raw bits
+    *symbol = br_peek(r, AD_BITS);
+    if (!br_skip(r, AD_BITS) || *symbol > AD_FLUSH ||
+        (*symbol < ALPHABET && a->leaf[*symbol] != NIL)) {
+      return 0;
+    }
+    depth += AD_BITS;
+  } else {
+    *symbol = a->symbol[n];
+  }
+  if (*symbol < ALPHABET) {
+    update(a, n, *symbol);
+  }
+  if (*symbol == AD_FLUSH) { // Drop the padding
+    depth += r->bits % 8;
+    br_skip(r, r->bits % 8);
+  }
+  return depth;
+}
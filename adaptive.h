@@ -0,0 +1,18 @@
+#pragma once
+
+#include "io.h"
+#include <stdint.h>
+
+typedef struct Adaptive Adaptive;
+
+Adaptive *ad_create(void);
+
+void ad_reset(Adaptive *a);
+
+void ad_delete(Adaptive **a);
+
+uint32_t ad_encode(Adaptive *a, BitWriter *w, uint16_t symbol);
+
+void ad_flush(Adaptive *a, BitWriter *w);
+
+uint32_t ad_decode(Adaptive *a, BitReader *r, uint16_t *symbol);
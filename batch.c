@@ -0,0 +1,294 @@
+// clang-format off
+#include "batch.h"		// Batch header file
+#include "huff.h"		// Huffman library header file
+#include "pool.h"		// Pool header file
+#include "stats.h"		// Stats header file
+#include "header.h"		// Headers header file
+#include "io.h"			// IO header file
+#include "defines.h"	// Defines header file
+
+#include <fcntl.h>		// Used for file functions
+#include <pthread.h>	// Used for mutexes
+#include <stdint.h>		// Declares more integer types
+#include <stdio.h>		// Used for input and output for our program
+#include <stdlib.h>		// Used for macros and functions used in our program
+#include <string.h>		// Used for strlen, memcpy and strcmp
+#include <sys/stat.h>	// Used for getting permission bits
+#include <unistd.h>		// Used for types and functions for our program
+// clang-format on
+
+// Batch mode codes many files in one process, one file per Job on a Pool, so
+// none of them pays for a process of its own. Every file is coded in memory
+// with libhuffman: a file is mapped, coded into one buffer and written out
+// with a single write. file is encoded to file.huff (BATCH_SUFFIX), and
+// file.huff is decoded back to file, or to file.out (BATCH_OUT) when it lacks
+// the suffix. A file that fails is reported and skipped; the rest go on.
+
+// Batch Struct, the settings and stats shared by every file of a batch
+typedef struct {
+  uint32_t block_size;  // Uncompressed bytes per block, 0 for the default
+  uint32_t limit;       // Longest code allowed, 0 for the default
+  Stats *stats;         // Stats of every file, may be NULL
+  pthread_mutex_t lock; // Guards stats
+} Batch;
+
+// FileJob Struct, one file of a batch
+typedef struct {
+  Batch *batch; // Batch the file belongs to
+  char *path;   // Path of the file
+  bool ok;      // Set once the file is coded and written
+} FileJob;
+
+// batch_list : Function that reads paths from list, one per line, ignoring
+// empty lines. Returns a malloc'd array of malloc'd paths and their number in
+// *count, or NULL if error.
+char **batch_list(FILE *list, uint32_t *count) {
+  char **paths = NULL;
+  uint32_t cap = 0;
+  char *line = NULL;
+  size_t size = 0;
+  ssize_t n = 0;
+  *count = 0;
+  while ((n = getline(&line, &size, list)) >= 0) {
+    if (n > 0 && line[n - 1] == '\n') {
+      line[n - 1] = '\0';
+      n -= 1;
+    }
+    if (n == 0) {
+      continue;
+    }
+    if (*count == cap) { // Double our array as paths come in
+      cap = cap ? 2 * cap : 64;
+      char **bigger = (char **)realloc(paths, cap * sizeof(char *));
+      if (bigger == NULL) {
+        break;
+      }
+      paths = bigger;
+    }
+    paths[*count] = strdup(line);
+    if (paths[*count] == NULL) {
+      break;
+    }
+    *count += 1;
+  }
+  free(line);
+  if (n >= 0) { // Stopped early, out of memory
+    while (*count > 0) {
+      *count -= 1;
+      free(paths[*count]);
+    }
+    free(paths);
+    return NULL;
+  }
+  return paths;
+}
+
+// out_path : Helper function that returns the malloc'd path the output of
+// path is written to, or NULL if error
+static char *out_path(char *path, bool decoding) {
+  size_t n = strlen(path);
+  size_t suffix = strlen(BATCH_SUFFIX);
+  char *out = (char *)malloc(n + suffix + strlen(BATCH_OUT) + 1);
+  if (out == NULL) {
+    return NULL;
+  }
+  strcpy(out, path);
+  if (!decoding) {
+    strcat(out, BATCH_SUFFIX);
+  } else if (n > suffix && strcmp(path + n - suffix, BATCH_SUFFIX) == 0) {
+    out[n - suffix] = '\0'; // file.huff goes back to file
+  } else {
+    strcat(out, BATCH_OUT);
+  }
+  return out;
+}
+
+// write_file : Helper function that writes the n bytes of buf to a new file
+// at path with the permission bits mode. Returns FALSE/0 if error.
+static bool write_file(char *path, uint8_t *buf, uint64_t n, mode_t mode) {
+  int outfile = open(path, O_CREAT | O_WRONLY | O_TRUNC, S_IRUSR | S_IWUSR);
+  if (outfile < 0) {
+    return 0;
+  }
+  bool ok = 1;
+  for (uint64_t i = 0; ok && i < n; i += BATCH_WRITE) {
+    int len = n - i < BATCH_WRITE ? n - i : BATCH_WRITE;
+    ok = write_bytes(outfile, buf + i, len) == len;
+  }
+  fchmod(outfile, mode);
+  return close(outfile) == 0 && ok;
+}
+
+// add_stats : Helper function that adds a file to the stats of a batch,
+// given its comp_size coded bytes and its raw_size bytes, both sound
+static void add_stats(Batch *b, uint8_t *comp, uint64_t comp_size,
+                      uint8_t *raw, uint64_t raw_size) {
+  if (b->stats == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&b->lock);
+  Stats *s = b->stats;
+  s->raw_size += raw_size;
+  s->comp_size += comp_size;
+  s->files += 1;
+  Header h;
+  memcpy(&h, comp, sizeof(Header));
+  uint64_t pos = sizeof(Header);
+  uint64_t raw_pos = 0;
+  BlockHeader bh;
+  while (h.magic == MAGIC_BLOCKS && pos + sizeof(bh) <= comp_size) {
+    memcpy(&bh, comp + pos, sizeof(bh));
+    if (bh.type == BLOCK_END) {
+      break;
+    }
+    stats_block(s, &bh, comp + pos + sizeof(bh), raw + raw_pos);
+    pos += sizeof(bh) + bh.comp_size;
+    raw_pos += bh.raw_size;
+  }
+  pthread_mutex_unlock(&b->lock);
+  return;
+}
+
+// encode_job : Helper function that encodes one file of a batch, a Job
+static void encode_job(void *arg) {
+  FileJob *j = (FileJob *)arg;
+  Batch *b = j->batch;
+  int infile = open(j->path, O_RDONLY);
+  struct stat s_buff;
+  if (infile < 0 || fstat(infile, &s_buff) < 0 || !S_ISREG(s_buff.st_mode)) {
+    fprintf(stderr, "encode: Couldn't open %s\n", j->path);
+    if (infile >= 0) {
+      close(infile);
+    }
+    return;
+  }
+  uint64_t size = 0;
+  uint8_t *src = map_input(infile, &size); // NULL for an empty file
+  close(infile);
+  HuffCtx *ctx = huff_create(b->block_size, b->limit);
+  uint64_t cap = ctx != NULL ? huff_bound(ctx, size) : 0;
+  uint8_t *dst = ctx != NULL ? (uint8_t *)malloc(cap) : NULL;
+  uint64_t n = dst != NULL ? huff_compress(ctx, src, size, dst, cap)
+                           : HUFF_ERROR;
+  char *out = out_path(j->path, 0);
+  if (n != HUFF_ERROR && out != NULL) {
+    Header h; // Keep the permission bits of the file, like ./encode does
+    memcpy(&h, dst, sizeof(Header));
+    h.permissions = s_buff.st_mode;
+    memcpy(dst, &h, sizeof(Header));
+    j->ok = write_file(out, dst, n, s_buff.st_mode);
+  }
+  if (j->ok) {
+    add_stats(b, dst, n, src, size);
+  } else {
+    fprintf(stderr, "encode: Couldn't encode %s\n", j->path);
+  }
+  free(out);
+  free(dst);
+  huff_delete(&ctx);
+  if (src != NULL) {
+    unmap_input(src, size);
+  }
+  return;
+}
+
+// decode_job : Helper function that decodes one file of a batch, a Job
+static void decode_job(void *arg) {
+  FileJob *j = (FileJob *)arg;
+  Batch *b = j->batch;
+  int infile = open(j->path, O_RDONLY);
+  uint64_t size = 0;
+  uint8_t *src = infile >= 0 ? map_input(infile, &size) : NULL;
+  if (infile >= 0) {
+    close(infile);
+  }
+  Header h;
+  if (src == NULL || size < sizeof(Header)) {
+    fprintf(stderr, "decode: Couldn't open %s\n", j->path);
+    if (src != NULL) {
+      unmap_input(src, size);
+    }
+    return;
+  }
+  memcpy(&h, src, sizeof(Header));
+  // Every code is at least a bit long, which caps the output at 8 bytes per
+  // input byte, even when the Header gives no size or a corrupt one
+  uint64_t cap = h.file_size < 8 * size ? h.file_size : 8 * size;
+  HuffCtx *ctx = huff_create(0, 0);
+  uint8_t *dst = (uint8_t *)malloc(cap ? cap : 1);
+  uint64_t n = ctx != NULL && dst != NULL
+                   ? huff_decompress(ctx, src, size, dst, cap)
+                   : HUFF_ERROR;
+  char *out = out_path(j->path, 1);
+  if (n != HUFF_ERROR && out != NULL) {
+    j->ok = write_file(out, dst, n, h.permissions);
+  }
+  if (j->ok) {
+    add_stats(b, src, size, dst, n);
+  } else {
+    fprintf(stderr, "decode: Couldn't decode %s\n", j->path);
+  }
+  free(out);
+  free(dst);
+  huff_delete(&ctx);
+  unmap_input(src, size);
+  return;
+}
+
+// batch_run : Helper function that runs job on every one of count paths on a
+// pool of threads worker threads. Returns FALSE/0 if any file failed.
+static bool batch_run(char **paths, uint32_t count, Job job, Batch *b,
+                      uint32_t threads) {
+  Pool *pool = pool_create(threads);
+  FileJob *jobs = (FileJob *)calloc(count ? count : 1, sizeof(FileJob));
+  if (pool == NULL || jobs == NULL) {
+    if (pool != NULL) {
+      pool_delete(&pool);
+    }
+    free(jobs);
+    return 0;
+  }
+  pthread_mutex_init(&b->lock, NULL);
+  for (uint32_t i = 0; i < count; i += 1) {
+    jobs[i].batch = b;
+    jobs[i].path = paths[i];
+    if (!pool_submit(pool, job, &jobs[i], NULL)) {
+      job(&jobs[i]); // Out of memory for a Task: code it ourselves
+    }
+  }
+  pool_wait(pool);
+  bool ok = 1;
+  for (uint32_t i = 0; i < count; i += 1) {
+    ok = ok && jobs[i].ok;
+  }
+  pthread_mutex_destroy(&b->lock);
+  pool_delete(&pool);
+  free(jobs);
+  return ok;
+}
+
+// batch_encode : Function that encodes every one of count paths to its own
+// .huff file, in blocks of block_size bytes with codes of at most limit bits
+// (0 picks the default for either), on a pool of threads worker threads.
+// Every file is added to stats unless it is NULL. Returns FALSE/0 if any
+// file failed.
+bool batch_encode(char **paths, uint32_t count, uint32_t block_size,
+                  uint32_t limit, uint32_t threads, Stats *stats) {
+  Batch b;
+  b.block_size = block_size;
+  b.limit = limit;
+  b.stats = stats;
+  return batch_run(paths, count, encode_job, &b, threads);
+}
+
+// batch_decode : Function that decodes every one of count paths, in any
+// format ./encode writes, on a pool of threads worker threads. Every file is
+// added to stats unless it is NULL. Returns FALSE/0 if any file failed.
+bool batch_decode(char **paths, uint32_t count, uint32_t threads,
+                  Stats *stats) {
+  Batch b;
+  b.block_size = 0;
+  b.limit = 0;
+  b.stats = stats;
+  return batch_run(paths, count, decode_job, &b, threads);
+}
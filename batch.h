@@ -0,0 +1,14 @@
+#pragma once
+
+#include "stats.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+char **batch_list(FILE *list, uint32_t *count);
+
+bool batch_encode(char **paths, uint32_t count, uint32_t block_size,
+                  uint32_t limit, uint32_t threads, Stats *stats);
+
+bool batch_decode(char **paths, uint32_t count, uint32_t threads,
+                  Stats *stats);
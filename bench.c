@@ -0,0 +1,457 @@
+// clang-format off
+#include "huff.h"		      // Huffman library header file
+#include "huffman.h"	  // Huffman header file
+#include "hist.h"	      // Histogram header file
+#include "table.h"	    // Decode Table header file
+#include "code.h"	      // Code header file
+#include "io.h"		      // IO Header File
+#include "defines.h"	  // Defines Header File
+
+#include <fcntl.h>	    // Used for file functions
+#include <stdint.h>	    // Declares more integer types
+#include <stdio.h>	    // Used for input and output for our program
+#include <stdlib.h>	    // Used for macros and functions used in our program
+#include <string.h>	    // Used for memset and strtok
+#include <sys/stat.h>	  // Used for getting file sizes
+#include <time.h>	      // Used for clock_gettime
+#include <unistd.h>	    // Used for types and functions for our program
+// clang-format on
+
+#define OPTIONS "hs:f:m:" // Valid User commands
+#define SEED 0x9E3779B97F4A7C15ULL // Seed for our generated corpora
+#define MAX_FILES 16 // Most corpus files the user can add
+#define MAX_INPUT (1 << 29) // Largest corpus; its bitstream must fit a
+                            // Bit Writer
+
+// help : Help message that displayes program synopsis and usage; prints to
+// stderr
+void help(void) {
+  fprintf(stderr,
+          "SYNOPSIS\n"
+          "  A Huffman benchmark.\n"
+          "  Times each phase of the codec over generated corpora and\n"
+          "  prints one CSV row per corpus, size and phase.\n"
+          "\n"
+          "USAGE\n"
+          "  ./benchmark [-h] [-s sizes] [-f file] [-m ms]\n"
+          "\n"
+          "OPTIONS\n"
+          "  -h             Program usage and help.\n"
+          "  -s sizes       Comma separated corpus sizes (suffix K or M,\n"
+          "                 default 64K,1M,16M).\n"
+          "  -f file        Also time file; may be given more than once.\n"
+          "  -m ms          Time each phase for at least ms ms (default "
+          "200).\n");
+  return;
+}
+
+// parse_size : Function that parses a size in bytes with an optional K or M
+// suffix. Returns 0 if str is not a size.
+static uint64_t parse_size(char *str) {
+  char *end;
+  uint64_t size = strtoull(str, &end, 10);
+  if (*end == 'K' || *end == 'k') {
+    size <<= 10;
+    end += 1;
+  } else if (*end == 'M' || *end == 'm') {
+    size <<= 20;
+    end += 1;
+  }
+  return *end == '\0' ? size : 0;
+}
+
+// Corpora are generated from a fixed seed with our own generator, so every
+// run on every machine times exactly the same bytes.
+
+// next_random : Helper function that returns the next number of a xorshift64
+// generator
+static uint64_t next_random(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+// gen_text : Generator for English-like text: common words drawn with Zipf
+// weights, split into lines
+static void gen_text(uint8_t *buf, uint64_t n, uint64_t *state) {
+  static char *words[] = {
+      "the",   "of",    "and",  "to",    "a",      "in",     "is",
+      "that",  "for",   "it",   "as",    "with",   "was",    "on",
+      "be",    "by",    "this", "are",   "from",   "or",     "have",
+      "not",   "which", "an",   "but",   "they",   "file",   "code",
+      "tree",  "block", "data", "bits",  "symbol", "length", "table",
+      "input", "output", "huffman", "compress", "frequency"};
+  uint32_t nwords = sizeof(words) / sizeof(words[0]);
+  uint64_t i = 0;
+  uint32_t column = 0;
+  while (i < n) {
+    // Zipf-ish pick: the k-th word is about k times rarer than the first
+    uint32_t w = (next_random(state) % 1000) * (next_random(state) % 1000) /
+                 (1000000 / nwords + 1);
+    char *word = words[w < nwords ? w : nwords - 1];
+    for (uint32_t j = 0; word[j] != '\0' && i < n; j += 1) {
+      buf[i++] = word[j];
+    }
+    column += strlen(word) + 1;
+    if (i < n) {
+      buf[i++] = column > 70 ? '\n' : ' ';
+      column = column > 70 ? 0 : column;
+    }
+  }
+  return;
+}
+
+// gen_binary : Generator for binary records: little endian 32-bit integers
+// that wander slowly, so their high bytes are mostly the same
+static void gen_binary(uint8_t *buf, uint64_t n, uint64_t *state) {
+  uint32_t value = 1 << 20;
+  for (uint64_t i = 0; i < n; i += 1) {
+    if (i % 4 == 0) {
+      value += (next_random(state) % 512) - 256;
+    }
+    buf[i] = value >> (8 * (i % 4));
+  }
+  return;
+}
+
+// gen_random : Generator for uniformly random bytes
+static void gen_random(uint8_t *buf, uint64_t n, uint64_t *state) {
+  for (uint64_t i = 0; i < n; i += 1) {
+    buf[i] = next_random(state);
+  }
+  return;
+}
+
+// gen_single : Generator for a single repeated symbol
+static void gen_single(uint8_t *buf, uint64_t n, uint64_t *state) {
+  (void)state;
+  memset(buf, 'a', n);
+  return;
+}
+
+// gen_fib : Generator for Fibonacci-skewed bytes: symbol s is drawn with a
+// weight of fib(s + 1), which gives the deepest possible Huffman trees
+static void gen_fib(uint8_t *buf, uint64_t n, uint64_t *state) {
+  uint64_t weights[32];
+  weights[0] = 1;
+  weights[1] = 1;
+  for (int s = 2; s < 32; s += 1) {
+    weights[s] = weights[s - 1] + weights[s - 2];
+  }
+  uint64_t total = 0;
+  for (int s = 0; s < 32; s += 1) {
+    total += weights[s];
+  }
+  for (uint64_t i = 0; i < n; i += 1) {
+    uint64_t pick = next_random(state) % total;
+    int s = 31;
+    while (pick >= weights[s]) { // Heaviest symbols first
+      pick -= weights[s];
+      s -= 1;
+    }
+    buf[i] = 'A' + s;
+  }
+  return;
+}
+
+// Corpus Struct, a named generator
+typedef struct {
+  char *name;
+  void (*generate)(uint8_t *buf, uint64_t n, uint64_t *state);
+} Corpus;
+
+static Corpus corpora[] = {{"text", gen_text},     {"binary", gen_binary},
+                           {"random", gen_random}, {"single", gen_single},
+                           {"fib", gen_fib}};
+
+// Run Struct, everything the phases of one input share
+typedef struct {
+  uint8_t *src;              // Input
+  uint64_t n;                // Size of src
+  uint64_t hist[ALPHABET];   // Histogram of src
+  Tree tree;                 // Huffman tree of hist
+  uint8_t lengths[ALPHABET]; // Length limited code lengths of hist
+  uint32_t words[ALPHABET];  // Canonical codes for lengths
+  uint8_t *bits;             // Bitstream of src
+  uint64_t nbits;            // Size of bits in bytes
+  uint8_t *back;             // Decoded bitstream
+  uint8_t *comp;             // Output of huff_compress
+  uint64_t comp_size;        // Size of comp
+  uint64_t comp_cap;         // Bytes allocated for comp
+  HuffCtx *ctx;              // Library context
+} Run;
+
+// phase_hist : Phase that counts the histogram of the input
+static void phase_hist(Run *r) {
+  memset(r->hist, 0, sizeof(r->hist));
+  hist_count(r->hist, r->src, r->n);
+  return;
+}
+
+// phase_tree : Phase that builds a Huffman tree from the histogram
+static void phase_tree(Run *r) {
+  build_tree(r->hist, &r->tree);
+  return;
+}
+
+// phase_codes : Phase that builds length limited canonical codes from the
+// histogram, as every block does
+static void phase_codes(Run *r) {
+  Code codes[ALPHABET];
+  for (int i = 0; i < ALPHABET; i += 1) {
+    codes[i] = code_init();
+  }
+  build_limited_lengths(r->hist, MAX_LIMIT, r->lengths);
+  canonical_codes(r->lengths, codes);
+  for (int i = 0; i < ALPHABET; i += 1) {
+    r->words[i] = code_word(&codes[i]);
+  }
+  return;
+}
+
+// phase_encode : Phase that writes the code of every input byte
+static void phase_encode(Run *r) {
+  BitWriter w;
+  bw_init(&w, -1, r->bits, r->n * MAX_LIMIT / 8 + 8);
+  for (uint64_t i = 0; i < r->n; i += 1) {
+    bw_write_bits(&w, r->words[r->src[i]], r->lengths[r->src[i]]);
+  }
+  r->nbits = bw_flush(&w);
+  return;
+}
+
+// phase_decode : Phase that builds a Decode Table and decodes the bitstream
+static void phase_decode(Run *r) {
+  Code codes[ALPHABET];
+  for (int i = 0; i < ALPHABET; i += 1) {
+    codes[i] = code_init();
+  }
+  canonical_codes(r->lengths, codes);
+  DecodeTable *t = dt_create(codes);
+  BitReader br;
+  br_init(&br, -1, r->bits, r->nbits);
+  for (uint64_t i = 0; i < r->n; i += MAX_BLOCK) {
+    dt_decode_bytes(t, &br, r->back + i,
+                    r->n - i < MAX_BLOCK ? r->n - i : MAX_BLOCK);
+  }
+  dt_delete(&t);
+  return;
+}
+
+// phase_compress : Phase that compresses the input with libhuffman
+static void phase_compress(Run *r) {
+  r->comp_size = huff_compress(r->ctx, r->src, r->n, r->comp, r->comp_cap);
+  return;
+}
+
+// phase_decompress : Phase that decompresses the input with libhuffman
+static void phase_decompress(Run *r) {
+  huff_decompress(r->ctx, r->comp, r->comp_size, r->back, r->n);
+  return;
+}
+
+// Phase Struct, a named step of the codec
+typedef struct {
+  char *name;
+  void (*run)(Run *r);
+} Phase;
+
+static Phase phases[] = {{"hist", phase_hist},
+                         {"tree", phase_tree},
+                         {"codes", phase_codes},
+                         {"encode", phase_encode},
+                         {"decode", phase_decode},
+                         {"compress", phase_compress},
+                         {"decompress", phase_decompress}};
+
+// now : Helper function that returns a monotonic time in nanoseconds
+static uint64_t now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// check_stored : Helper function that wraps n bytes of src in a stored file,
+// the way ./encode writes incompressible input, and makes sure libhuffman
+// gives them back whole, by range and streamed. Returns FALSE/0 if the round
+// trip fails or if error.
+static bool check_stored(HuffCtx *ctx, uint8_t *src, uint64_t n,
+                         uint8_t *back) {
+  uint8_t *file = (uint8_t *)malloc(sizeof(Header) + n);
+  if (file == NULL) {
+    return 0;
+  }
+  Header h = {MAGIC_STORED, 0644, 0, n};
+  memcpy(file, &h, sizeof(Header));
+  memcpy(file + sizeof(Header), src, n);
+  uint64_t size = sizeof(Header) + n;
+  bool ok = huff_decompress(ctx, file, size, back, n) == n &&
+            memcmp(back, src, n) == 0;
+  uint64_t third = n / 3; // Range over the middle third
+  ok = ok && huff_decompress_range(ctx, file, size, third, third, back, n) ==
+                 third &&
+       memcmp(back, src + third, third) == 0;
+  huff_reset(ctx);
+  uint64_t got = 0;
+  for (uint64_t fed = 0; ok && !huff_done(ctx); fed += 4096) {
+    uint64_t k = size - fed < 4096 ? size - fed : 4096; // A piece at a time
+    uint64_t out = huff_stream_decompress(ctx, file + fed, k, back + got,
+                                          n - got);
+    ok = out != HUFF_ERROR && (k > 0 || huff_done(ctx));
+    got += ok ? out : 0;
+  }
+  ok = ok && got == n && memcmp(back, src, n) == 0;
+  free(file);
+  return ok;
+}
+
+// bench : Function that times every phase over n bytes of src and prints a
+// CSV row for each. Phases run in order, since each one needs the output of
+// the ones before it. Returns FALSE/0 if the round trip fails or if error.
+static bool bench(char *name, uint8_t *src, uint64_t n, uint64_t min_ns) {
+  Run *r = (Run *)calloc(1, sizeof(Run));
+  if (r == NULL) {
+    return 0;
+  }
+  r->src = src;
+  r->n = n;
+  r->ctx = huff_create(0, 0);
+  r->bits = (uint8_t *)malloc(n * MAX_LIMIT / 8 + 8);
+  r->back = (uint8_t *)malloc(n + 1);
+  r->comp_cap = r->ctx == NULL ? 0 : huff_bound(r->ctx, n);
+  r->comp = (uint8_t *)malloc(r->comp_cap);
+  bool ok = r->ctx != NULL && r->bits != NULL && r->back != NULL &&
+            r->comp != NULL;
+  if (ok) { // Every row reports the ratio, so compress once up front
+    phase_compress(r);
+  }
+  for (uint32_t p = 0; ok && p < sizeof(phases) / sizeof(phases[0]); p += 1) {
+    uint64_t best = UINT64_MAX; // Fastest run; the least disturbed one
+    uint64_t total = 0;
+    uint32_t runs = 0;
+    while (total < min_ns || runs < 3) {
+      uint64_t start = now();
+      phases[p].run(r);
+      uint64_t ns = now() - start;
+      best = ns < best ? ns : best;
+      total += ns;
+      runs += 1;
+    }
+    if (phases[p].run == phase_decode || phases[p].run == phase_decompress) {
+      ok = memcmp(r->back, src, n) == 0; // Make sure we time a real decoder
+    }
+    double ns_per_byte = n ? (double)best / n : 0;
+    printf("%s,%lu,%s,%u,%lu,%.3f,%.1f,%.4f\n", name, n, phases[p].name,
+           runs, best, ns_per_byte, ns_per_byte ? 1000 / ns_per_byte : 0,
+           (double)n / r->comp_size);
+    fflush(stdout);
+  }
+  ok = ok && check_stored(r->ctx, src, n, r->back);
+  huff_delete(&r->ctx);
+  free(r->bits);
+  free(r->back);
+  free(r->comp);
+  free(r);
+  return ok;
+}
+
+// load : Helper function that reads all of a file. Returns it and its size
+// in *n, or NULL if error.
+static uint8_t *load(char *path, uint64_t *n) {
+  int infile = open(path, O_RDONLY);
+  struct stat s_buff;
+  if (infile < 0 || fstat(infile, &s_buff) < 0) {
+    return NULL;
+  }
+  *n = s_buff.st_size;
+  uint8_t *buf = *n > MAX_INPUT ? NULL : (uint8_t *)malloc(*n + 1);
+  uint64_t got = 0;
+  while (buf != NULL && got < *n) {
+    int k = read_bytes(infile, buf + got,
+                       *n - got < (1 << 30) ? *n - got : (1 << 30));
+    if (k < 0) { // Only ever time whole files
+      free(buf);
+      buf = NULL;
+    }
+    if (k <= 0) {
+      break;
+    }
+    got += k;
+  }
+  close(infile);
+  *n = got;
+  return buf;
+}
+
+// main : main function for benchmark
+int main(int argc, char **argv) {
+  int opt = 0;
+  char sizes_default[] = "64K,1M,16M";
+  char *sizes = sizes_default; // Sizes of the generated corpora
+  char *files[MAX_FILES];      // Extra corpus files
+  uint32_t nfiles = 0;
+  uint64_t min_ns = 200000000; // Least time spent timing each phase
+
+  while ((opt = getopt(argc, argv, OPTIONS)) != -1) {
+    switch (opt) {
+    case 's': // User wants other corpus sizes
+      sizes = optarg;
+      break;
+    case 'f': // User wants to time a file too
+      if (nfiles == MAX_FILES) {
+        fprintf(stderr, "benchmark: At most %d files\n", MAX_FILES);
+        exit(EXIT_FAILURE);
+      }
+      files[nfiles++] = optarg;
+      break;
+    case 'm': // User wants to time each phase for longer or shorter
+      min_ns = strtoull(optarg, NULL, 10) * 1000000;
+      break;
+    case 'h':
+      help();
+      exit(EXIT_SUCCESS);
+    default:
+      help();
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  bool ok = 1;
+  printf("corpus,bytes,phase,runs,ns,ns_per_byte,mb_per_s,ratio\n");
+  for (char *size = strtok(sizes, ","); size != NULL;
+       size = strtok(NULL, ",")) {
+    uint64_t n = parse_size(size);
+    if (n == 0 || n > MAX_INPUT) {
+      fprintf(stderr, "benchmark: Invalid size %s\n", size);
+      help();
+      exit(EXIT_FAILURE);
+    }
+    uint8_t *buf = (uint8_t *)malloc(n);
+    if (buf == NULL) {
+      fprintf(stderr, "benchmark: Out of memory\n");
+      exit(EXIT_FAILURE);
+    }
+    for (uint32_t c = 0; c < sizeof(corpora) / sizeof(corpora[0]); c += 1) {
+      uint64_t state = SEED; // Same bytes on every run
+      corpora[c].generate(buf, n, &state);
+      ok = bench(corpora[c].name, buf, n, min_ns) && ok;
+    }
+    free(buf);
+  }
+  for (uint32_t f = 0; f < nfiles; f += 1) {
+    uint64_t n = 0;
+    uint8_t *buf = load(files[f], &n);
+    if (buf == NULL || n == 0 || n > MAX_INPUT) {
+      fprintf(stderr, "benchmark: Couldn't read %s\n", files[f]);
+      exit(EXIT_FAILURE);
+    }
+    ok = bench(files[f], buf, n, min_ns) && ok;
+    free(buf);
+  }
+  if (!ok) {
+    fprintf(stderr, "benchmark: Round trip failed\n");
+    exit(EXIT_FAILURE);
+  }
+  exit(EXIT_SUCCESS);
+}
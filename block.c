@@ -0,0 +1,810 @@
+// clang-format off
+#include "block.h"		// Block header file
+#include "huffman.h"	// Huffman header file
+#include "header.h"		// Headers header file
+#include "table.h"		// Decode Table header file
+#include "code.h"		// Code header file
+#include "pool.h"		// Pool header file
+#include "hist.h"		// Histogram header file
+#include "stats.h"		// Stats header file
+#include "io.h"			// IO header file
+#include "defines.h"	// Defines header file
+
+#include <stdint.h>		// Declares more integer types
+#include <stdio.h>		// Used for input and output for our program
+#include <stdlib.h>		// Used for macros and functions used in our program
+#include <string.h>		// Used for memcpy
+// clang-format on
+
+// A framed file is a Header (magic MAGIC_BLOCKS) followed by independent
+// blocks. Each block is a BlockHeader, its code tables and its own
+// bitstreams of canonical codes, so blocks can be coded on separate threads.
+// A BLOCK_HUFFMAN block has one table, its packed code lengths. Each byte of
+// a BLOCK_CONTEXT block is coded with the table of its context, the byte
+// before it; its tables are the number of tables, the table of each of the
+// ALPHABET contexts, one byte each, then every table as a uint16_t size
+// followed by its packed code lengths.
+// The bytes of a block are cut into streams (1 if 0) segments of equal size,
+// but for a shorter last one, each coded into a bitstream of its own with
+// the same codes. The first byte of every segment has context 0. A jump
+// table of the sizes of every bitstream but the last, one uint32_t each,
+// sits between the code tables and the bitstreams.
+// A BLOCK_STORED block has no tables and no bitstreams, just its raw bytes;
+// blocks whose codes would not make them any smaller are stored instead.
+// The last block has type BLOCK_END and holds the block index: one
+// IndexEntry per block followed by a Trailer.
+
+// Tables Struct, the code tables of a block and the table of every context
+typedef struct {
+  uint32_t count;                       // Number of tables
+  uint8_t map[ALPHABET];                // Table of every context
+  uint8_t lengths[CTX_TABLES][ALPHABET]; // Code lengths of every table
+  uint32_t words[CTX_TABLES][ALPHABET];  // Codes of every table, as words
+} Tables;
+
+// set_words : Helper function that turns the code lengths of every table
+// into canonical codes
+static void set_words(Tables *t) {
+  for (uint32_t k = 0; k < t->count; k += 1) {
+    Code codes[ALPHABET];
+    for (int i = 0; i < ALPHABET; i += 1) {
+      codes[i] = code_init();
+    }
+    canonical_codes(t->lengths[k], codes);
+    for (int i = 0; i < ALPHABET; i += 1) {
+      t->words[k][i] = code_word(&codes[i]);
+    }
+  }
+  return;
+}
+
+// context_tables : Helper function that builds the tables of a BLOCK_CONTEXT
+// block for n bytes of src cut into segments of seg bytes, with codes of at
+// most limit bits and no more than tables tables, and packs them into
+// packed. Returns the size of the block's tables and bitstreams, give or
+// take the padding of its bitstreams, or UINT64_MAX if error.
+static uint64_t context_tables(uint8_t *src, uint32_t n, uint32_t seg,
+                               uint32_t limit, uint32_t tables, Tables *t,
+                               uint8_t packed[static MAX_TABLES],
+                               uint16_t *packed_size) {
+  uint32_t(*hist)[ALPHABET] =
+      (uint32_t(*)[ALPHABET])calloc(ALPHABET, sizeof(*hist));
+  if (hist == NULL) {
+    return UINT64_MAX;
+  }
+  for (uint32_t i = 0; i < n; i += seg) { // Contexts start over every segment
+    hist_pairs(hist, src + i, n - i < seg ? n - i : seg);
+  }
+  uint64_t clusters[CTX_TABLES][ALPHABET];
+  t->count = cluster_contexts(hist, tables, t->map, clusters);
+  uint64_t bits = 0;
+  bool ok = 1;
+  for (uint32_t k = 0; ok && k < t->count; k += 1) {
+    ok = build_limited_lengths(clusters[k], limit, t->lengths[k]);
+  }
+  for (int c = 0; ok && c < ALPHABET; c += 1) {
+    for (int i = 0; i < ALPHABET; i += 1) {
+      bits += (uint64_t)hist[c][i] * t->lengths[t->map[c]][i];
+    }
+  }
+  free(hist);
+  if (!ok) {
+    return UINT64_MAX;
+  }
+  packed[0] = t->count;
+  memcpy(packed + 1, t->map, ALPHABET);
+  *packed_size = 1 + ALPHABET;
+  for (uint32_t k = 0; k < t->count; k += 1) {
+    uint16_t size = pack_lengths(t->lengths[k], packed + *packed_size + 2);
+    memcpy(packed + *packed_size, &size, 2);
+    *packed_size += 2 + size;
+  }
+  return *packed_size + (bits + 7) / 8;
+}
+
+// code_streams : Helper function that codes n bytes of src, cut into
+// segments of seg bytes, into a bitstream per segment at p, after their jump
+// table. Returns the number of bytes written, or 0 if error.
+static uint32_t code_streams(uint8_t *src, uint32_t n, uint32_t seg,
+                             uint32_t streams, Tables *t, uint8_t *p,
+                             uint32_t cap) {
+  uint32_t sizes[MAX_STREAMS]; // Exact size of each bitstream
+  uint64_t bytes = 4 * (streams - 1);
+  for (uint32_t s = 0; s < streams; s += 1) {
+    uint64_t nbits = 0;
+    uint8_t prev = 0;
+    for (uint32_t i = s * seg; i < n && i < (s + 1) * seg; i += 1) {
+      nbits += t->lengths[t->map[prev]][src[i]];
+      prev = src[i];
+    }
+    sizes[s] = (nbits + 7) / 8;
+    bytes += sizes[s];
+  }
+  if (bytes > cap) {
+    return 0;
+  }
+  memcpy(p, sizes, 4 * (streams - 1)); // Our jump table
+  p += 4 * (streams - 1);
+  for (uint32_t s = 0; s < streams; s += 1) {
+    BitWriter w; // Writes our codes straight into the block
+    bw_init(&w, -1, p, sizes[s]);
+    if (t->count == 1) { // One table: no need to track contexts
+      uint32_t *words = t->words[0];
+      uint8_t *lengths = t->lengths[0];
+      for (uint32_t i = s * seg; i < n && i < (s + 1) * seg; i += 1) {
+        bw_write_bits(&w, words[src[i]], lengths[src[i]]);
+      }
+    } else {
+      uint8_t prev = 0;
+      for (uint32_t i = s * seg; i < n && i < (s + 1) * seg; i += 1) {
+        uint8_t k = t->map[prev];
+        bw_write_bits(&w, t->words[k][src[i]], t->lengths[k][src[i]]);
+        prev = src[i];
+      }
+    }
+    bw_flush(&w);
+    p += sizes[s];
+  }
+  return bytes;
+}
+
+// block_encode : Function that compresses n (> 0) bytes of src into a
+// self-contained block, BlockHeader included, with codes of at most limit
+// bits, cut into streams (1 to MAX_STREAMS) bitstreams. With model
+// BLOCK_CONTEXT, order-1 context tables are used if they make the block
+// smaller. Blocks no codes make smaller are stored instead. Returns the
+// malloc'd block and its size in *size, or NULL if error.
+uint8_t *block_encode(uint8_t *src, uint32_t n, uint32_t limit,
+                      uint32_t streams, uint8_t model, uint32_t *size) {
+  streams = streams < n ? streams : n; // No empty streams
+  uint32_t seg = (n + streams - 1) / streams;
+  uint64_t hist[ALPHABET] = {0}; // Histogram of just this block
+  hist_count(hist, src, n);
+  Tables *t = (Tables *)malloc(sizeof(Tables));
+  if (t == NULL) {
+    return NULL;
+  }
+  t->count = 1;
+  memset(t->map, 0, ALPHABET);
+  if (!build_limited_lengths(hist, limit, t->lengths[0])) {
+    free(t);
+    return NULL;
+  }
+  uint8_t packed[MAX_TABLES];
+  BlockHeader bh;
+  bh.raw_size = n;
+  bh.table_size = pack_lengths(t->lengths[0], packed);
+  bh.type = BLOCK_HUFFMAN;
+  bh.streams = streams;
+
+  uint64_t bits = 0; // Size of our order-0 codes
+  for (int i = 0; i < ALPHABET; i += 1) {
+    bits += hist[i] * t->lengths[0][i];
+  }
+  uint64_t best = bh.table_size + (bits + 7) / 8; // Size of our best codes
+
+  // Context tables cost up to MAX_LENS_SIZE bytes each, so a block only
+  // gets one per CTX_MIN_BYTES bytes, and only keeps them if they pay off
+  uint32_t tables = n / CTX_MIN_BYTES < CTX_TABLES ? n / CTX_MIN_BYTES
+                                                   : CTX_TABLES;
+  if (model == BLOCK_CONTEXT && tables > 1) {
+    Tables *ctx = (Tables *)malloc(sizeof(Tables));
+    uint8_t ctx_packed[MAX_TABLES];
+    uint16_t ctx_size = 0;
+    uint64_t ctx_best =
+        ctx == NULL ? UINT64_MAX
+                    : context_tables(src, n, seg, limit, tables, ctx,
+                                     ctx_packed, &ctx_size);
+    if (ctx_best < best) {
+      free(t);
+      t = ctx;
+      ctx = NULL;
+      memcpy(packed, ctx_packed, ctx_size);
+      bh.table_size = ctx_size;
+      bh.type = BLOCK_CONTEXT;
+      best = ctx_best;
+    }
+    free(ctx);
+  }
+
+  // Blocks that are already compressed or random don't get any smaller, so
+  // they are stored as they are, which also skips coding them
+  if (best + 4 * (streams - 1) >= n) {
+    free(t);
+    uint8_t *out = (uint8_t *)malloc(sizeof(BlockHeader) + n);
+    if (out == NULL) {
+      return NULL;
+    }
+    bh.comp_size = n;
+    bh.table_size = 0;
+    bh.type = BLOCK_STORED;
+    bh.streams = 1;
+    memcpy(out, &bh, sizeof(BlockHeader));
+    memcpy(out + sizeof(BlockHeader), src, n);
+    *size = sizeof(BlockHeader) + n;
+    return out;
+  }
+  set_words(t);
+
+  // The bitstreams never take more than limit bits a byte, plus padding
+  uint64_t cap = 4 * (streams - 1) + ((uint64_t)n * limit + 7) / 8 + streams;
+  uint8_t *out =
+      (uint8_t *)malloc(sizeof(BlockHeader) + bh.table_size + cap);
+  if (out == NULL) {
+    free(t);
+    return NULL;
+  }
+  uint8_t *p = out + sizeof(BlockHeader);
+  memcpy(p, packed, bh.table_size);
+  uint32_t bytes = code_streams(src, n, seg, streams, t,
+                                p + bh.table_size, cap);
+  free(t);
+  if (bytes == 0) { // Never emit a block whose bitstreams weren't written
+    free(out);
+    return NULL;
+  }
+  bh.comp_size = bh.table_size + bytes;
+  memcpy(out, &bh, sizeof(BlockHeader));
+  *size = sizeof(BlockHeader) + bh.comp_size;
+  return out;
+}
+
+// block_check : Function that returns TRUE/1 if the sizes in the header of a
+// block that is not BLOCK_END are sane enough to allocate buffers for
+bool block_check(BlockHeader *bh) {
+  return bh->raw_size > 0 && bh->raw_size <= MAX_BLOCK &&
+         bh->comp_size <=
+             MAX_TABLES + 5 * MAX_STREAMS + 4 * (uint64_t)bh->raw_size;
+}
+
+// read_table : Helper function that builds a Decode Table from nbytes of
+// packed code lengths. Returns NULL if they are malformed or if error.
+static DecodeTable *read_table(uint8_t *packed, uint32_t nbytes) {
+  uint8_t lengths[ALPHABET];
+  Code codes[ALPHABET];
+  for (int i = 0; i < ALPHABET; i += 1) {
+    codes[i] = code_init();
+  }
+  if (nbytes > MAX_LENS_SIZE || !unpack_lengths(nbytes, packed, lengths) ||
+      !canonical_codes(lengths, codes)) {
+    return NULL;
+  }
+  return dt_create(codes);
+}
+
+// read_tables : Helper function that builds the Decode Tables of a block and
+// points every context at its table in ctx. Returns the number of tables,
+// or 0 if they are malformed or if error.
+static uint32_t read_tables(BlockHeader *bh, uint8_t *payload,
+                            DecodeTable *tables[static CTX_TABLES],
+                            DecodeTable *ctx[static ALPHABET]) {
+  if (bh->type == BLOCK_HUFFMAN) {
+    tables[0] = read_table(payload, bh->table_size);
+    for (int c = 0; c < ALPHABET; c += 1) {
+      ctx[c] = tables[0];
+    }
+    return tables[0] != NULL;
+  }
+  if (bh->table_size < 1 + ALPHABET) { // Too small to hold count and map
+    return 0;
+  }
+  uint32_t count = payload[0];
+  if (count < 1 || count > CTX_TABLES) {
+    return 0;
+  }
+  uint8_t *map = payload + 1;
+  uint32_t pos = 1 + ALPHABET;
+  uint32_t k = 0;
+  for (; k < count; k += 1) {
+    uint16_t size = 0;
+    if (bh->table_size - pos < 2) {
+      break;
+    }
+    memcpy(&size, payload + pos, 2);
+    pos += 2;
+    if (bh->table_size - pos < size) {
+      break;
+    }
+    tables[k] = read_table(payload + pos, size);
+    pos += size;
+    if (tables[k] == NULL) {
+      break;
+    }
+  }
+  for (int c = 0; k == count && c < ALPHABET; c += 1) {
+    if (map[c] >= count) {
+      break;
+    }
+    ctx[c] = tables[map[c]];
+    if (c == ALPHABET - 1) {
+      return count;
+    }
+  }
+  while (k > 0) { // Malformed: drop the tables we built
+    k -= 1;
+    dt_delete(&tables[k]);
+  }
+  return 0;
+}
+
+// block_decode : Function that decompresses the payload of a block described
+// by bh into bh->raw_size bytes at dst. Returns FALSE/0 if the block is
+// malformed.
+bool block_decode(BlockHeader *bh, uint8_t *payload, uint8_t *dst) {
+  if (bh->type == BLOCK_STORED) { // Nothing to decode, just copy it out
+    if (bh->comp_size != bh->raw_size) {
+      return 0;
+    }
+    memcpy(dst, payload, bh->raw_size);
+    return 1;
+  }
+  uint32_t streams = bh->streams ? bh->streams : 1;
+  uint32_t jump = 4 * (streams - 1); // Size of our jump table
+  if ((bh->type != BLOCK_HUFFMAN && bh->type != BLOCK_CONTEXT) ||
+      bh->table_size > MAX_TABLES || streams > MAX_STREAMS ||
+      streams > bh->raw_size || bh->table_size + jump > bh->comp_size) {
+    return 0;
+  }
+  DecodeTable *tables[CTX_TABLES];
+  DecodeTable *ctx[ALPHABET]; // Table of every context
+  uint32_t count = read_tables(bh, payload, tables, ctx);
+  if (count == 0) {
+    return 0;
+  }
+  BitReader r[MAX_STREAMS]; // Read codes straight out of the block
+  uint8_t *out[MAX_STREAMS];
+  uint32_t n[MAX_STREAMS];
+  uint8_t *bits = payload + bh->table_size + jump;
+  uint32_t left = bh->comp_size - bh->table_size - jump; // Bitstream bytes
+  uint32_t seg = (bh->raw_size + streams - 1) / streams;
+  bool ok = 1;
+  for (uint32_t s = 0; ok && s < streams; s += 1) {
+    uint32_t size = left; // The last bitstream takes what is left
+    if (s + 1 < streams) {
+      memcpy(&size, payload + bh->table_size + 4 * s, 4);
+    }
+    ok = size <= left;
+    br_init(&r[s], -1, bits, size);
+    bits += size;
+    left -= size;
+    uint32_t start = s * seg < bh->raw_size ? s * seg : bh->raw_size;
+    out[s] = dst + start;
+    n[s] = bh->raw_size - start < seg ? bh->raw_size - start : seg;
+  }
+  if (bh->type == BLOCK_HUFFMAN) {
+    ok = ok && dt_decode_streams(tables[0], r, out, n, streams);
+  } else {
+    ok = ok && dt_decode_contexts(ctx, r, out, n, streams);
+  }
+  for (uint32_t k = 0; k < count; k += 1) {
+    dt_delete(&tables[k]);
+  }
+  return ok;
+}
+
+// EncodeJob Struct, one block handed to a worker thread
+typedef struct {
+  uint8_t *src;     // Raw bytes of the block
+  uint8_t *buf;     // Buffer src is read into, NULL if src points into a map
+  uint32_t n;       // Number of bytes in src
+  uint32_t limit;   // Longest code allowed
+  uint32_t streams; // Bitstreams the block is cut into
+  uint8_t model;    // Type of block to try for
+  uint8_t *out;     // Encoded block, NULL if error
+  uint32_t size;    // Size of out
+  bool done;        // Set by our Pool once the block is encoded
+} EncodeJob;
+
+// encode_job : Helper function that runs block_encode for a worker
+static void encode_job(void *arg) {
+  EncodeJob *j = (EncodeJob *)arg;
+  j->out =
+      block_encode(j->src, j->n, j->limit, j->streams, j->model, &j->size);
+  return;
+}
+
+// index_add : Function that adds a block of raw_size bytes, encoded into
+// comp_size bytes, to the end of a block index. Returns FALSE/0 if error.
+bool index_add(BlockIndex *index, uint32_t raw_size, uint32_t comp_size) {
+  if (index->blocks == index->capacity) { // Grow our index
+    uint32_t capacity = index->capacity ? 2 * index->capacity : 64;
+    IndexEntry *grown = (IndexEntry *)realloc(
+        index->entries, capacity * sizeof(IndexEntry));
+    if (grown == NULL) {
+      return 0;
+    }
+    index->entries = grown;
+    index->capacity = capacity;
+  }
+  index->entries[index->blocks].raw_offset = index->raw_offset;
+  index->entries[index->blocks].comp_offset = index->comp_offset;
+  index->blocks += 1;
+  index->raw_offset += raw_size;
+  index->comp_offset += comp_size;
+  return 1;
+}
+
+// index_size : Function that returns the size of the BLOCK_END block holding
+// a block index
+uint32_t index_size(BlockIndex *index) {
+  return sizeof(BlockHeader) + index->blocks * sizeof(IndexEntry) +
+         sizeof(Trailer);
+}
+
+// index_pack : Function that writes the BLOCK_END block holding a block
+// index, index_size bytes, to dst
+void index_pack(BlockIndex *index, uint8_t *dst) {
+  BlockHeader end;
+  end.raw_size = 0;
+  end.comp_size = index->blocks * sizeof(IndexEntry) + sizeof(Trailer);
+  end.table_size = 0;
+  end.type = BLOCK_END;
+  end.streams = 0;
+  memcpy(dst, &end, sizeof(BlockHeader));
+  dst += sizeof(BlockHeader);
+  memcpy(dst, index->entries, index->blocks * sizeof(IndexEntry));
+  dst += index->blocks * sizeof(IndexEntry);
+  Trailer t;
+  t.blocks = index->blocks;
+  t.magic = MAGIC_BLOCKS;
+  memcpy(dst, &t, sizeof(Trailer));
+  return;
+}
+
+// index_read : Function that loads the block index at the end of a framed
+// file, size bytes at src, into index, reusing its entries if they are big
+// enough. Afterwards raw_offset holds the uncompressed size of the file and
+// comp_offset the offset of its BLOCK_END block. Returns FALSE/0 if src is
+// not a framed file with a sane index or if error.
+bool index_read(uint8_t *src, uint64_t size, BlockIndex *index) {
+  Header h;
+  Trailer t;
+  BlockHeader end;
+  if (size < sizeof(Header) + sizeof(BlockHeader) + sizeof(Trailer)) {
+    return 0;
+  }
+  memcpy(&h, src, sizeof(Header));
+  memcpy(&t, src + size - sizeof(Trailer), sizeof(Trailer));
+  uint64_t most = (size - sizeof(Header) - sizeof(BlockHeader) -
+                   sizeof(Trailer)) / sizeof(IndexEntry); // Most that fit
+  if (h.magic != MAGIC_BLOCKS || t.magic != MAGIC_BLOCKS || t.blocks > most) {
+    return 0;
+  }
+  uint64_t end_offset = size - sizeof(Trailer) - t.blocks * sizeof(IndexEntry) -
+                        sizeof(BlockHeader);
+  memcpy(&end, src + end_offset, sizeof(BlockHeader));
+  if (end.type != BLOCK_END ||
+      end.comp_size != t.blocks * sizeof(IndexEntry) + sizeof(Trailer)) {
+    return 0;
+  }
+  if (t.blocks > index->capacity) {
+    IndexEntry *grown = (IndexEntry *)realloc(
+        index->entries, t.blocks * sizeof(IndexEntry));
+    if (grown == NULL) {
+      return 0;
+    }
+    index->entries = grown;
+    index->capacity = t.blocks;
+  }
+  memcpy(index->entries, src + end_offset + sizeof(BlockHeader),
+         t.blocks * sizeof(IndexEntry));
+  index->blocks = t.blocks;
+  index->raw_offset = 0;
+  index->comp_offset = end_offset;
+
+  // Blocks must follow each other, in the file and in the uncompressed data,
+  // from just after the Header to the BLOCK_END block
+  uint64_t comp = sizeof(Header);
+  for (uint32_t i = 0; i < index->blocks; i += 1) {
+    IndexEntry *e = &index->entries[i];
+    if (e->comp_offset != comp || e->raw_offset != index->raw_offset ||
+        end_offset - comp < sizeof(BlockHeader)) {
+      return 0;
+    }
+    memcpy(&end, src + comp, sizeof(BlockHeader));
+    if (end.raw_size == 0 ||
+        end.comp_size > end_offset - comp - sizeof(BlockHeader)) {
+      return 0;
+    }
+    comp += sizeof(BlockHeader) + end.comp_size;
+    index->raw_offset = e->raw_offset + end.raw_size;
+  }
+  return comp == end_offset;
+}
+
+// index_find : Function that returns the number of the block holding the
+// uncompressed byte at offset, which must be less than index->raw_offset
+uint32_t index_find(BlockIndex *index, uint64_t offset) {
+  uint32_t lo = 0;
+  uint32_t hi = index->blocks - 1;
+  while (lo < hi) { // Last block starting at or before offset
+    uint32_t mid = lo + (hi - lo + 1) / 2;
+    if (index->entries[mid].raw_offset <= offset) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return lo;
+}
+
+// write_index : Helper function that writes the BLOCK_END block holding the
+// block index to outfile. Returns FALSE/0 if it couldn't be written whole or
+// if error.
+static bool write_index(int outfile, BlockIndex *index) {
+  uint8_t *buf = (uint8_t *)malloc(index_size(index));
+  if (buf == NULL) {
+    return 0;
+  }
+  index_pack(index, buf);
+  bool ok = write_bytes(outfile, buf, index_size(index)) ==
+            (int)index_size(index);
+  free(buf);
+  return ok;
+}
+
+// write_block : Helper function that writes an encoded block to outfile and
+// adds it to our index and, if not NULL, our stats. Returns FALSE/0 if the
+// block couldn't be written whole or if error.
+static bool write_block(int outfile, EncodeJob *j, BlockIndex *index,
+                        Stats *stats) {
+  if (j->out == NULL) {
+    return 0;
+  }
+  bool ok = index_add(index, j->n, j->size);
+  if (ok) {
+    ok = write_bytes(outfile, j->out, j->size) == (int)j->size;
+  }
+  if (ok && stats != NULL) {
+    stats_block(stats, (BlockHeader *)j->out, j->out + sizeof(BlockHeader),
+                j->src);
+  }
+  free(j->out);
+  j->out = NULL;
+  return ok;
+}
+
+// encode_blocks : Function that compresses infile into blocks of block_size
+// bytes, each cut into streams bitstreams and coded as model allows (see
+// block_encode), on a pool of threads worker threads and writes them to
+// outfile in order, followed by the block index. infile is read once, front
+// to back, so it may be a pipe; regular files are mapped and their blocks
+// encoded in place. Blocks are written as soon as they and every block
+// before them are encoded. Must be called right after the Header is written.
+// Every block is added to stats unless it is NULL. Returns FALSE/0 if
+// infile couldn't be read, if outfile couldn't be written whole or if error.
+bool encode_blocks(int infile, int outfile, uint32_t block_size,
+                   uint32_t limit, uint32_t streams, uint8_t model,
+                   uint32_t threads, Stats *stats) {
+  Pool *pool = pool_create(threads);
+  if (pool == NULL) {
+    return 0;
+  }
+  uint32_t slots = 2 * pool_threads(pool); // Blocks in flight at once
+  EncodeJob *jobs = (EncodeJob *)calloc(slots, sizeof(EncodeJob));
+  bool ok = jobs != NULL;
+  uint64_t map_size = 0;
+  uint8_t *map = map_input(infile, &map_size);
+  uint64_t mapped = 0; // Bytes of the mapping handed out so far
+  for (uint32_t i = 0; ok && map == NULL && i < slots; i += 1) {
+    jobs[i].buf = (uint8_t *)malloc(block_size);
+    ok = jobs[i].buf != NULL;
+  }
+
+  BlockIndex index = {NULL, 0, 0, 0, sizeof(Header)};
+  uint32_t head = 0;     // Slot of the oldest block in flight
+  uint32_t inflight = 0; // Number of blocks in flight
+  bool done = !ok;
+  while (!done || inflight > 0) {
+    // Write out the oldest block once it is ready; wait for it only if we
+    // have no free slot or nothing left to read
+    if (inflight > 0 && (inflight == slots || done ||
+                         pool_finished(pool, &jobs[head].done))) {
+      pool_wait_for(pool, &jobs[head].done);
+      ok = write_block(outfile, &jobs[head], &index, stats) && ok;
+      done = done || !ok; // Stop reading once anything went wrong
+      head = (head + 1) % slots;
+      inflight -= 1;
+      continue;
+    }
+    // Read the next block into a free slot and hand it to the pool
+    EncodeJob *j = &jobs[(head + inflight) % slots];
+    if (map != NULL) { // Point the block straight into the mapping
+      j->src = map + mapped;
+      j->n = map_size - mapped < block_size ? map_size - mapped : block_size;
+      mapped += j->n;
+      bytes_read += j->n; // Count mapped bytes as read to keep stats right
+    } else {
+      j->src = j->buf;
+      int n = read_bytes(infile, j->src, block_size);
+      ok = n >= 0 && ok; // A failed read is not the end of infile
+      j->n = n < 0 ? 0 : n;
+    }
+    if (j->n < block_size) { // A short read means we hit the end
+      done = 1;
+    }
+    if (j->n == 0) {
+      continue;
+    }
+    j->limit = limit;
+    j->streams = streams;
+    j->model = model;
+    pool_submit(pool, encode_job, j, &j->done);
+    inflight += 1;
+  }
+  if (ok) {
+    ok = write_index(outfile, &index);
+  }
+
+  pool_delete(&pool);
+  for (uint32_t i = 0; jobs != NULL && i < slots; i += 1) {
+    free(jobs[i].buf);
+  }
+  free(jobs);
+  free(index.entries);
+  if (map != NULL) {
+    unmap_input(map, map_size);
+  }
+  return ok;
+}
+
+// DecodeJob Struct, one block handed to a worker thread
+typedef struct {
+  BlockHeader bh;       // Header of the block
+  uint8_t *src;         // Code lengths and bitstream of the block
+  uint8_t *payload;     // Buffer src is copied into if in is not in memory
+  uint32_t payload_cap; // Bytes allocated for payload
+  uint8_t *raw;         // Decoded bytes of the block
+  uint32_t raw_cap;     // Bytes allocated for raw
+  bool ok;              // Set if the block decoded cleanly
+  bool done;            // Set by our Pool once the block is decoded
+} DecodeJob;
+
+// decode_job : Helper function that runs block_decode for a worker
+static void decode_job(void *arg) {
+  DecodeJob *j = (DecodeJob *)arg;
+  j->ok = block_decode(&j->bh, j->src, j->raw);
+  return;
+}
+
+// reserve : Helper function that makes sure *buf holds at least size bytes.
+// Returns FALSE/0 if error.
+static bool reserve(uint8_t **buf, uint32_t *cap, uint32_t size) {
+  if (size > *cap) {
+    uint8_t *grown = (uint8_t *)realloc(*buf, size);
+    if (grown == NULL) {
+      return 0;
+    }
+    *buf = grown;
+    *cap = size;
+  }
+  return 1;
+}
+
+// read_block : Helper function that reads the next block of in into a
+// DecodeJob. Payloads of memory backed readers are used in place, anything
+// else is copied out. Returns FALSE/0 at the BLOCK_END block, or with *ok
+// cleared if in is malformed or truncated.
+static bool read_block(BitReader *in, DecodeJob *j, bool *ok) {
+  if (br_read_bytes(in, (uint8_t *)&j->bh, sizeof(BlockHeader)) !=
+      sizeof(BlockHeader)) {
+    *ok = 0; // Ran out of input before the BLOCK_END block
+    return 0;
+  }
+  if (j->bh.type == BLOCK_END) { // Nothing but the index is left
+    return 0;
+  }
+  if (!block_check(&j->bh) || !reserve(&j->raw, &j->raw_cap, j->bh.raw_size)) {
+    *ok = 0;
+    return 0;
+  }
+  j->src = br_view(in, j->bh.comp_size);
+  if (j->src == NULL) { // Not in memory; copy the payload out
+    if (!reserve(&j->payload, &j->payload_cap, j->bh.comp_size) ||
+        br_read_bytes(in, j->payload, j->bh.comp_size) != j->bh.comp_size) {
+      *ok = 0;
+      return 0;
+    }
+    j->src = j->payload;
+  }
+  return 1;
+}
+
+// decode_blocks : Function that decompresses the blocks read from in on a
+// pool of threads worker threads and writes them to outfile in order. in is
+// read once, front to back, so it may be backed by a pipe; each block is
+// written as soon as it and every block before it are decoded. Must be
+// called right after the Header is read. Every block is added to stats
+// unless it is NULL. Returns FALSE/0 if the input is malformed, if a block
+// couldn't be written whole or if error.
+bool decode_blocks(BitReader *in, int outfile, uint32_t threads,
+                   Stats *stats) {
+  Pool *pool = pool_create(threads);
+  if (pool == NULL) {
+    return 0;
+  }
+  uint32_t slots = 2 * pool_threads(pool); // Blocks in flight at once
+  DecodeJob *jobs = (DecodeJob *)calloc(slots, sizeof(DecodeJob));
+  bool ok = jobs != NULL;
+  uint32_t head = 0;     // Slot of the oldest block in flight
+  uint32_t inflight = 0; // Number of blocks in flight
+  bool done = !ok;
+  while (!done || inflight > 0) {
+    // Write out the oldest block once it is ready; wait for it only if we
+    // have no free slot or nothing left to read
+    if (inflight > 0 && (inflight == slots || done ||
+                         pool_finished(pool, &jobs[head].done))) {
+      pool_wait_for(pool, &jobs[head].done);
+      if (ok && jobs[head].ok &&
+          write_bytes(outfile, jobs[head].raw, jobs[head].bh.raw_size) ==
+              (int)jobs[head].bh.raw_size) {
+        if (stats != NULL) {
+          stats_block(stats, &jobs[head].bh, jobs[head].src, jobs[head].raw);
+        }
+      } else {
+        ok = 0;
+        done = 1; // Stop reading once anything went wrong
+      }
+      head = (head + 1) % slots;
+      inflight -= 1;
+      continue;
+    }
+    // Read the next block into a free slot and hand it to the pool
+    DecodeJob *j = &jobs[(head + inflight) % slots];
+    if (!read_block(in, j, &ok)) {
+      done = 1;
+      continue;
+    }
+    pool_submit(pool, decode_job, j, &j->done);
+    inflight += 1;
+  }
+
+  pool_delete(&pool);
+  for (uint32_t i = 0; jobs != NULL && i < slots; i += 1) {
+    free(jobs[i].payload);
+    free(jobs[i].raw);
+  }
+  free(jobs);
+  return ok;
+}
+
+// decode_range : Function that decompresses length bytes of a framed file,
+// starting offset bytes into its uncompressed data, using the index
+// index_read loaded from the file at src. Only the blocks holding the range
+// are decoded. The bytes are written to outfile, or to dst if outfile is -1.
+// The range must lie within the file. Returns FALSE/0 if a block is
+// malformed, if the range couldn't be written whole or if error.
+bool decode_range(uint8_t *src, BlockIndex *index, uint64_t offset,
+                  uint64_t length, int outfile, uint8_t *dst) {
+  uint8_t *raw = NULL; // Whole blocks, the range is copied out of them
+  uint32_t raw_cap = 0;
+  bool ok = 1;
+  for (uint32_t i = length ? index_find(index, offset) : index->blocks;
+       ok && i < index->blocks && length > 0; i += 1) {
+    BlockHeader bh;
+    memcpy(&bh, src + index->entries[i].comp_offset, sizeof(BlockHeader));
+    if (!block_check(&bh)) {
+      ok = 0;
+      break;
+    }
+    uint8_t *payload = src + index->entries[i].comp_offset + sizeof(bh);
+    uint64_t skip = offset - index->entries[i].raw_offset; // Before range
+    uint64_t n = bh.raw_size - skip < length ? bh.raw_size - skip : length;
+    if (outfile < 0 && skip == 0 && n == bh.raw_size) { // Whole block
+      ok = block_decode(&bh, payload, dst);
+    } else {
+      ok = reserve(&raw, &raw_cap, bh.raw_size) &&
+           block_decode(&bh, payload, raw);
+      if (ok && outfile < 0) {
+        memcpy(dst, raw + skip, n);
+      } else if (ok) {
+        ok = write_bytes(outfile, raw + skip, n) == (int)n;
+      }
+    }
+    dst = outfile < 0 ? dst + n : dst;
+    offset += n;
+    length -= n;
+  }
+  free(raw);
+  return ok;
+}
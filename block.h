@@ -0,0 +1,42 @@
+#pragma once
+
+#include "header.h"
+#include "io.h"
+#include "stats.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    IndexEntry *entries;  // One entry per block
+    uint32_t blocks;      // Number of entries
+    uint32_t capacity;    // Number of entries allocated
+    uint64_t raw_offset;  // Uncompressed offset of the next block
+    uint64_t comp_offset; // Compressed offset of the next block
+} BlockIndex;
+
+uint8_t *block_encode(uint8_t *src, uint32_t n, uint32_t limit,
+                      uint32_t streams, uint8_t model, uint32_t *size);
+
+bool block_check(BlockHeader *bh);
+
+bool block_decode(BlockHeader *bh, uint8_t *payload, uint8_t *dst);
+
+bool index_add(BlockIndex *index, uint32_t raw_size, uint32_t comp_size);
+
+uint32_t index_size(BlockIndex *index);
+
+void index_pack(BlockIndex *index, uint8_t *dst);
+
+bool index_read(uint8_t *src, uint64_t size, BlockIndex *index);
+
+uint32_t index_find(BlockIndex *index, uint64_t offset);
+
+bool encode_blocks(int infile, int outfile, uint32_t block_size,
+                   uint32_t limit, uint32_t streams, uint8_t model,
+                   uint32_t threads, Stats *stats);
+
+bool decode_blocks(BitReader *in, int outfile, uint32_t threads,
+                   Stats *stats);
+
+bool decode_range(uint8_t *src, BlockIndex *index, uint64_t offset,
+                  uint64_t length, int outfile, uint8_t *dst);
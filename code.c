@@ -38,9 +38,9 @@ bool code_empty(Code *c) {
 // code_full: Function that returns TRUE/1 if the stack is full. Else it returns
 // FALSE/0
 bool code_full(Code *c) {
-  if (code_size(c) == MAX_CODE_SIZE) {
-    return 1; // If the top component is MAX_CODE_SIZE - 1, this indicates that
-              // the stack full
+  if (code_size(c) == MAX_CODE_SIZE * 8) {
+    return 1; // If the top component is the number of bits in our array, this
+              // indicates that the stack full
   }
   return 0;
 }
@@ -48,7 +48,7 @@ bool code_full(Code *c) {
 // code_set_bit: Function that will set the bit at index i. Returns TRUE/1 if
 // able to set. Else it returns FALSE/0
 bool code_set_bit(Code *c, uint32_t i) {
-  if (0 < i < code_size(c)) { // If the index i is in range
+  if (i < code_size(c)) { // If the index i is in range
     uint8_t byte = i / 8;     // Finds what 'block' the bit is in
     uint8_t bit =
         i % 8; // Finds the corresponding 'bit' the bit is in within the 'block'
@@ -62,7 +62,7 @@ bool code_set_bit(Code *c, uint32_t i) {
 // code_clr_bit: Function that will set the bit at index i. Returns TRUE/1 if
 // able to clear. Else it returns FALSE/0
 bool code_clr_bit(Code *c, uint32_t i) {
-  if (0 < i < code_size(c)) { // If the index i is in range
+  if (i < code_size(c)) { // If the index i is in range
     uint8_t byte = i / 8;     // Finds what 'block' the bit is in
     uint8_t bit =
         i % 8; // Finds the corresponding 'bit' the bit is in within the 'block'
@@ -76,7 +76,7 @@ bool code_clr_bit(Code *c, uint32_t i) {
 // code_get_bit: Function that will get the bit at index i. Returns TRUE/1 if
 // the bit at i is 1. Else it returns FALSE/0
 bool code_get_bit(Code *c, uint32_t i) {
-  if (0 < i < code_size(c)) { // If the index i is in range
+  if (i < code_size(c)) { // If the index i is in range
     uint8_t byte = i / 8;     // Finds what 'block' the bit is in
     uint8_t bit =
         i % 8; // Finds the corresponding 'bit' the bit is in within the 'block'
@@ -118,7 +118,17 @@ bool code_pop_bit(Code *c, uint8_t *bit) {
   return 1;                        // Return 1 because we popped a bit
 }
 
-// code_pop_bit: Function that will iterate through our code from 0 -> TOP
+// code_word: Function that returns the first (up to) 64 bits of our Code
+// packed into a word, with bit 0 of the Code in bit 0 of the word
+uint64_t code_word(Code *c) {
+  uint64_t word = 0;
+  for (uint32_t i = 0; i < code_size(c) && i < 64; i += 1) {
+    word |= (uint64_t)code_get_bit(c, i) << i;
+  }
+  return word;
+}
+
+// code_print: Function that will iterate through our code from 0 -> TOP
 void code_print(Code *c) {
   for (uint32_t i = 0; i < code_size(c); i += 1) {
     printf("%d", code_get_bit(c, i));
@@ -27,4 +27,6 @@ bool code_push_bit(Code *c, uint8_t bit);
 
 bool code_pop_bit(Code *c, uint8_t *bit);
 
+uint64_t code_word(Code *c);
+
 void code_print(Code *c);
@@ -1,11 +1,19 @@
 // clang-format off
 #include "io.h"		      // IO Header File
-#include "huffman.h"	  // Huffman header file
-#include "code.h"	      // Code header file
 #include "defines.h"	  // Defines Header File
 #include "header.h"	    // Headers Header File
+#include "table.h"	    // Decode Table Header File
+#include "block.h"	    // Block Header File
+#include "hist.h"	      // Histogram Header File
+#include "stats.h"	    // Stats Header File
+#include "adaptive.h"	  // Adaptive Header File
+#include "dict.h"	      // Dictionary Header File
+#include "batch.h"	    // Batch Header File
+#include "stage.h"	    // Stage Header File
 
 #include <fcntl.h>	    // Used for file functions
+#include <getopt.h>	    // Used for long options
+#include <string.h>	    // Used for strcmp and memcpy
 #include <sys/stat.h>	  // Used for getting permission bits
 #include <stdint.h>	    // Declares more integer types
 #include <stdio.h>	    // Used for input and output for our program
@@ -13,7 +21,11 @@
 #include <unistd.h>	    // Used for types and functions for our program
 // clang-format on
 
-#define OPTIONS "hi:o:v" // Valid User commands
+#define OPTIONS "hi:o:vt:r:D:PB" // Valid User commands
+
+// Valid long User commands
+static struct option long_options[] = {{"stats", required_argument, 0, 'S'},
+                                       {0, 0, 0, 0}};
 
 // help : Help message that displayes program synopsis and usage; prints to
 // stderr
@@ -23,25 +35,69 @@ void help(void) {
                   "  Decompresses a file using the Huffman coding algorithm.\n"
                   "\n"
                   "USAGE\n"
-                  "  ./decode [-h] [-i infile] [-o outfile]\n"
+                  "  ./decode [-h] [-v] [--stats=format] [-t threads]\n"
+                  "           [-r offset:length] [-D dict] [-P] [-i infile]\n"
+                  "           [-o outfile] [-B [file ...]]\n"
                   "\n"
                   "OPTIONS\n"
                   "  -h             Program usage and help.\n"
                   "  -v             Print compression statistics.\n"
+                  "  --stats=format Print them as text or json.\n"
+                  "  -t threads     Decode blocks on threads threads. With -B,\n"
+                  "                 decode files on threads threads (default\n"
+                  "                 every core).\n"
+                  "  -r off:len     Decode only len bytes starting off bytes\n"
+                  "                 in; needs a framed infile. Without len,\n"
+                  "                 decode to the end.\n"
+                  "  -D dict        Dictionary infile was coded with.\n"
+                  "  -P             Pipeline: read and write ahead while\n"
+                  "                 decoding, on io_uring for files or threads\n"
+                  "                 of their own otherwise, instead of\n"
+                  "                 mapping infile. Not with -r.\n"
                   "  -i infile      Input file to decompress.\n"
-                  "  -o outfile     Output of decompressed data.\n");
+                  "  -o outfile     Output of decompressed data.\n"
+                  "  -B [file ...]  Batch: decode every file named, or listed\n"
+                  "                 one per line on stdin, in one process;\n"
+                  "                 file.huff to file, others to file.out.\n"
+                  "                 Takes -t and -v only.\n");
   return;
 }
 
+// parse_range : Function that parses a range given as offset:length, or just
+// offset: for everything from offset on. Returns FALSE/0 if str is not a
+// range.
+bool parse_range(char *str, uint64_t *offset, uint64_t *length) {
+  char *end;
+  *offset = strtoull(str, &end, 10);
+  if (end == str || *end != ':') {
+    return 0;
+  }
+  str = end + 1;
+  if (*str == '\0') { // No length, so we decode to the end
+    *length = UINT64_MAX;
+    return 1;
+  }
+  *length = strtoull(str, &end, 10);
+  return end != str && *end == '\0';
+}
+
 // main : main function for decode
 int main(int argc, char **argv) {
   int opt = 0;                 // Used to store the current user input
   int infile = STDIN_FILENO;   // Used to store the input file to decode
   int outfile = STDOUT_FILENO; // Used to store the output file to decode
-  bool stats = 0; // Used to indicate if the user wants to print out the
-                  // decompression stats
+  uint8_t stats = 0; // Used to indicate if and how the user wants to print
+                     // out the decompression stats
+  uint32_t threads = 0; // Number of threads decoding blocks; 0 for default
+  bool range = 0;       // Set if the user only wants a range of bytes
+  uint64_t offset = 0;  // Uncompressed offset of the range
+  uint64_t length = 0;  // Number of bytes in the range
+  Dictionary dict;      // Shared codes from a dictionary
+  bool shared = 0;      // Set if the user gave one
+  bool batch = 0;       // Set if the user wants batch mode
+  bool pipelined = 0;   // Set if the user wants IO on threads of its own
 
-  while ((opt = getopt(argc, argv, OPTIONS)) !=
+  while ((opt = getopt_long(argc, argv, OPTIONS, long_options, NULL)) !=
          -1) {     // Go in a loop to handle users input(s)
     switch (opt) { // Use switch to handle users input
     case 'i':      // User wants to specify the input file to decode
@@ -60,11 +116,61 @@ int main(int argc, char **argv) {
 
     case 'o': // User wants to specify the output file to decode
       // Opening output file for decoding; will create if does not exist
-      outfile = open(optarg, O_CREAT | O_WRONLY | O_TRUNC, S_IRWXU);
+      outfile = open(optarg, O_CREAT | O_RDWR | O_TRUNC,
+                     S_IRWXU); // Readable too, so it can be mapped
       break; // Break; ensures we only go through this case
 
     case 'v': // User wants to print out the decompression stats after program
-      stats = 1;
+      stats = STATS_TEXT;
+      break; // Break; ensures we only go through this case
+
+    case 'S': // User wants the decompression stats in a given format
+      if (strcmp(optarg, "json") == 0) {
+        stats = STATS_JSON;
+      } else if (strcmp(optarg, "text") == 0) {
+        stats = STATS_TEXT;
+      } else {
+        fprintf(stderr, "decode: Stats format must be text or json\n");
+        help();             // Print the programs synopsis and usage
+        exit(EXIT_FAILURE); // Exit with non-zero exit code
+      }
+      break; // Break; ensures we only go through this case
+
+    case 't': // User wants to decode blocks on several threads
+      threads = strtoul(optarg, NULL, 10);
+      if (threads < 1) {
+        fprintf(stderr, "decode: Need at least 1 thread\n");
+        help();             // Print the programs synopsis and usage
+        exit(EXIT_FAILURE); // Exit with non-zero exit code
+      }
+      break; // Break; ensures we only go through this case
+
+    case 'D': { // User gave the dictionary infile was coded with
+      int dictfile = open(optarg, O_RDONLY);
+      if (dictfile < 0 || !dict_load(dictfile, &dict)) {
+        fprintf(stderr, "decode: Couldn't load dictionary %s\n", optarg);
+        exit(EXIT_FAILURE); // Exit with non-zero exit code
+      }
+      close(dictfile);
+      shared = 1;
+      break; // Break; ensures we only go through this case
+    }
+
+    case 'r': // User only wants a range of the decompressed bytes
+      range = parse_range(optarg, &offset, &length);
+      if (!range) {
+        fprintf(stderr, "decode: Range must be offset:length\n");
+        help();             // Print the programs synopsis and usage
+        exit(EXIT_FAILURE); // Exit with non-zero exit code
+      }
+      break; // Break; ensures we only go through this case
+
+    case 'P': // User wants reading, decoding and writing to overlap
+      pipelined = 1;
+      break; // Break; ensures we only go through this case
+
+    case 'B': // User wants to decode many files in one process
+      batch = 1;
       break; // Break; ensures we only go through this case
 
     case 'h':             // User wants to displays program synopsis and usage
@@ -79,35 +185,74 @@ int main(int argc, char **argv) {
     }
   }
 
-  // If input comes from stdin, we will put input into a temp file first
-  uint8_t buff = '\0';
-  // Read all bytes from stdin and write to temp file
-  if (infile == STDIN_FILENO) {
-    FILE *temp_file =
-        tmpfile(); // Referenced :
-                   // https://www.tutorialspoint.com/c_standard_library/c_function_tmpfile.htm
-    int temp = fileno(
-        temp_file); // Referenced :
-                    // https://man7.org/linux/man-pages/man3/fileno.3.html
-    while (read_bytes(infile, &buff, 1) > 0) {
-      write_bytes(temp, &buff, 1);
+  // Collecting stats as we go, phase by phase
+  Stats report;
+  stats_init(&report);
+
+  if (batch) { // Batch mode: every file is decoded on its own on a pool
+    if (range || shared || pipelined || infile != STDIN_FILENO ||
+        outfile != STDOUT_FILENO) {
+      fprintf(stderr, "decode: -B only takes -t and -v\n");
+      help();             // Print the programs synopsis and usage
+      exit(EXIT_FAILURE); // Exit with non-zero exit code
     }
-    free(temp_file);
-    infile = temp;
+    uint32_t count = argc - optind;
+    char **paths = argv + optind;
+    if (count == 0) { // No files named, so they are listed on stdin
+      paths = batch_list(stdin, &count);
+      if (paths == NULL) {
+        fprintf(stderr, "decode: Couldn't read file list\n");
+        exit(EXIT_FAILURE); // Exit with non-zero exit code
+      }
+    }
+    stats_phase(&report, "batch");
+    bool ok = batch_decode(paths, count,
+                           threads ? threads : sysconf(_SC_NPROCESSORS_ONLN),
+                           stats ? &report : NULL);
+    if (stats) { // If our user enabled verbose to print out stats
+      stats_print(&report, 1, stats);
+    }
+    exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
   }
-  // Reset stats
-  bytes_read = 0;
-  bytes_written = 0;
 
-  // Starting at the beginning of infile
-  lseek(infile, 0, SEEK_SET);
+  stats_phase(&report, "header");
+
+  // Everything is read through one buffered reader front to back, so infile
+  // may be a pipe or socket and decoding starts as soon as bytes arrive
+  uint8_t buff[IO_BLOCK]; // Buffer for decoded symbols
+  uint8_t bits[IO_BLOCK]; // Buffer our bit reader refills from infile
+  BitReader reader;
+  uint64_t map_size = 0;
+  uint8_t *map = NULL;
+  Stage *input = NULL; // Reads infile ahead of us when pipelined
+  if (pipelined && range) {
+    fprintf(stderr, "decode: -P can't be used with -r\n");
+    exit(EXIT_FAILURE); // Exit with non-zero exit code
+  }
+  if (pipelined) {
+    input = stage_create(infile, 0);
+  } else {
+    map = map_input(infile, &map_size);
+  }
+  if (input != NULL) { // Pipelined: decode the buffers read on a thread
+    br_init_stage(&reader, input);
+  } else if (map != NULL) { // Regular files are decoded straight out of the
+    br_init(&reader, -1, map, map_size); // mapping
+    bytes_read += map_size; // Count mapped bytes as read to keep stats right
+  } else {
+    br_init(&reader, infile, bits, IO_BLOCK);
+  }
 
   // Getting our header from infile
   Header h;
-  read_bytes(infile, (uint8_t *)&h, sizeof(h));
+  if (br_read_bytes(&reader, (uint8_t *)&h, sizeof(h)) != sizeof(h)) {
+    h.magic = 0; // Too short to hold a header
+  }
 
   // Verifying magic number
-  if (h.magic != MAGIC) {
+  if (h.magic != MAGIC && h.magic != MAGIC_CANON && h.magic != MAGIC_SHARED &&
+      h.magic != MAGIC_BLOCKS && h.magic != MAGIC_ADAPT &&
+      h.magic != MAGIC_STORED) {
     // In the case of a non-matching magic number
     fprintf(stderr, "decode: Header doesn't match magic number\n");
     help();             // Print the programs synopsis and usage
@@ -117,52 +262,258 @@ int main(int argc, char **argv) {
   // Changing permissions of outfile based on header
   fchmod(outfile, h.permissions);
 
-  // Rebuilding our huffman tree based on tree size from header
-  uint8_t tree[MAX_TREE_SIZE];
-  Node *huff_tree = rebuild_tree(read_bytes(infile, tree, h.tree_size), tree);
-
-  // Decoding bits to symbols
-  uint8_t cur_bit; // Will contain the current bit from our in file
-  Node *cur_node =
-      huff_tree; // Create a node that starts from the root of our huffman tree
-
-  // Start decoding the bits into symbols
-  while (bytes_written <
-         h.file_size) { // Since we know that the number of bytes written has to
-                        // equal the number of bytes of the original file
-    if (!read_bit(infile, &cur_bit)) { // If read_bit returns 0; there are no
-                                       // more bits to read; break
-      break;
+  if (range) { // Seek to the blocks holding the range through the index
+    if (h.magic != MAGIC_BLOCKS || map == NULL) {
+      fprintf(stderr, "decode: -r needs a framed file that can be mapped\n");
+      exit(EXIT_FAILURE); // Exit with non-zero exit code
+    }
+    stats_phase(&report, "index");
+    BlockIndex index = {NULL, 0, 0, 0, 0};
+    if (!index_read(map, map_size, &index)) {
+      fprintf(stderr, "decode: Corrupt block index\n");
+      exit(EXIT_FAILURE); // Exit with non-zero exit code
     }
-    if (cur_node->left == NULL &&
-        cur_node->right == NULL) { // If the node is a leaf node
-      write_bytes(outfile, &(cur_node->symbol),
-                  1); // Write the symbol of the current node
-      cur_node =
-          huff_tree; // Reset our cur node to the root of our huffman tree
+    offset = offset < index.raw_offset ? offset : index.raw_offset;
+    length = length < index.raw_offset - offset ? length
+                                                : index.raw_offset - offset;
+    stats_phase(&report, "range");
+    if (!decode_range(map, &index, offset, length, outfile, NULL)) {
+      fprintf(stderr, "decode: Corrupt or truncated block, or couldn't write "
+                      "outfile\n");
+      exit(EXIT_FAILURE); // Exit with non-zero exit code
     }
-    if (cur_bit) {
-      cur_node = cur_node->right; // If the current bit is 1; traverse through
-                                  // the cur Nodes right link
-    } else {
-      cur_node = cur_node->left; // If the current bit is 0; traverse through
-                                 // the cur Nodes left link
+    if (stats) { // If our user enabled verbose to print out stats
+      report.raw_size = bytes_written;
+      report.comp_size = 0; // Only count the blocks we had to decode
+      if (length > 0) {
+        uint32_t first = index_find(&index, offset);
+        uint32_t last = index_find(&index, offset + length - 1);
+        report.comp_size = (last + 1 < index.blocks
+                                ? index.entries[last + 1].comp_offset
+                                : index.comp_offset) -
+                           index.entries[first].comp_offset;
+      }
+      report.payload_bytes = report.comp_size;
+      stats_print(&report, 1, stats);
     }
+    free(index.entries);
+    unmap_input(map, map_size);
+    close(infile);
+    close(outfile);
+    exit(EXIT_SUCCESS); // Exits indicating a successful termination
+  }
+
+  if (h.magic == MAGIC_STORED) { // Stored file: copy it out as it is
+    stats_phase(&report, "store");
+    uint64_t copied = 0;
+    if (map != NULL) { // Straight from infile, in the kernel where we can
+      lseek(infile, sizeof(Header), SEEK_CUR);
+      copied = copy_bytes(infile, outfile, h.file_size);
+    } else { // Through our reader, which may have read ahead of the header
+      uint32_t got = 0;
+      do {
+        uint32_t want =
+            h.file_size - copied < IO_BLOCK ? h.file_size - copied : IO_BLOCK;
+        got = br_read_bytes(&reader, buff, want);
+        copied += write_bytes(outfile, buff, got);
+      } while (got > 0 && copied < h.file_size);
+    }
+    if (copied != h.file_size) {
+      fprintf(stderr, "decode: Truncated stored file\n");
+      exit(EXIT_FAILURE); // Exit with non-zero exit code
+    }
+    if (input != NULL && !stage_finish(&input)) {
+      fprintf(stderr, "decode: Couldn't read infile\n");
+      exit(EXIT_FAILURE); // Exit with non-zero exit code
+    }
+    if (stats) { // If our user enabled verbose to print out stats
+      report.raw_size = copied;
+      report.comp_size = sizeof(Header) + copied;
+      report.payload_bytes = copied;
+      stats_print(&report, 1, stats);
+    }
+    if (map != NULL) {
+      unmap_input(map, map_size);
+    }
+    close(infile);
+    close(outfile);
+    exit(EXIT_SUCCESS); // Exits indicating a successful termination
+  }
+
+  if (h.magic == MAGIC_ADAPT) { // Adaptive codes: learn them as we go
+    stats_phase(&report, "adaptive");
+    Adaptive *tree = ad_create();
+    if (tree == NULL) {
+      fprintf(stderr, "decode: Couldn't create adaptive tree\n");
+      exit(EXIT_FAILURE); // Exit with non-zero exit code
+    }
+    uint64_t decoded = 0;
+    uint32_t got = 0; // Number of symbols in buff
+    uint16_t symbol = 0;
+    uint32_t len = 0;
+    while ((len = ad_decode(tree, &reader, &symbol)) > 0 && symbol != AD_END) {
+      if (symbol < ALPHABET) {
+        buff[got] = symbol;
+        got += 1;
+      }
+      if (stats && symbol < ALPHABET) {
+        report.hist[symbol] += 1;
+        report.code_bits += len;
+        report.max_len = len > report.max_len ? len : report.max_len;
+      }
+      // Hand out what we have whenever the encoder did, before our reader
+      // has to wait on more input
+      if (got == IO_BLOCK || symbol == AD_FLUSH) {
+        write_bytes(outfile, buff, got);
+        decoded += got;
+        got = 0;
+      }
+    }
+    write_bytes(outfile, buff, got);
+    decoded += got;
+    ad_delete(&tree);
+    if (len == 0 || (h.file_size != UNKNOWN_SIZE && decoded != h.file_size)) {
+      fprintf(stderr, "decode: Corrupt or truncated adaptive codes\n");
+      exit(EXIT_FAILURE); // Exit with non-zero exit code
+    }
+    if (stats) { // If our user enabled verbose to print out stats
+      report.raw_size = bytes_written;
+      report.comp_size = bytes_read;
+      report.payload_bytes = bytes_read - sizeof(Header);
+      stats_print(&report, 1, stats);
+    }
+    if (map != NULL) {
+      unmap_input(map, map_size);
+    }
+    close(infile);
+    close(outfile);
+    exit(EXIT_SUCCESS); // Exits indicating a successful termination
+  }
+
+  if (h.magic == MAGIC_BLOCKS) { // Framed file: decode its blocks in parallel
+    stats_phase(&report, "blocks"); // Reading, decoding and writing overlap
+    if (!decode_blocks(&reader, outfile, threads ? threads : 1, stats ? &report : NULL)) {
+      fprintf(stderr, "decode: Corrupt or truncated block, or couldn't write "
+                      "outfile\n");
+      exit(EXIT_FAILURE); // Exit with non-zero exit code
+    }
+    if (stats) { // If our user enabled verbose to print out stats
+      report.raw_size = bytes_written;
+      report.comp_size = bytes_read;
+      stats_print(&report, 1, stats);
+    }
+    close(infile);
+    close(outfile);
+    exit(EXIT_SUCCESS); // Exits indicating a successful termination
+  }
+
+  // Building a Decode Table from the tree or code lengths in the header, or
+  // from the dictionary it names
+  stats_phase(&report, "table");
+  uint8_t lengths[ALPHABET]; // Code lengths, for our stats
+  DecodeTable *table = NULL;
+  if (h.magic == MAGIC_SHARED) {
+    uint32_t id = 0;
+    if (h.tree_size != sizeof(id) ||
+        br_read_bytes(&reader, (uint8_t *)&id, sizeof(id)) != sizeof(id) ||
+        !shared || id != dict.id) {
+      fprintf(stderr, "decode: Needs dictionary %08x (see -D)\n", id);
+      exit(EXIT_FAILURE); // Exit with non-zero exit code
+    }
+    Code codes[ALPHABET];
+    dict_codes(&dict, codes);
+    memcpy(lengths, dict.lengths, ALPHABET);
+    table = dt_create(codes);
+  } else {
+    table = dt_read(&h, &reader, lengths);
+  }
+  if (table == NULL) {
+    fprintf(stderr, "decode: Invalid code table in header\n");
+    exit(EXIT_FAILURE); // Exit with non-zero exit code
+  }
+
+  // Decoding bits to symbols, one table lookup per symbol, a block at a time
+  stats_phase(&report, "decode");
+  uint64_t hist[ALPHABET] = {0}; // Histogram of the decoded symbols
+  uint64_t decoded = 0;
+  Stage *output = pipelined ? stage_create(outfile, 1) : NULL; // Writes our
+                                       // symbols out behind us when pipelined
+  // Otherwise, as we know the size of outfile up front, a regular outfile is
+  // allocated and mapped so symbols are decoded straight into it, and a pipe
+  // is handed fresh pages of symbols instead of copies of them
+  uint8_t *dst = output == NULL ? map_output(outfile, h.file_size) : NULL;
+  struct stat o_buff;
+  bool gifting = output == NULL && dst == NULL &&
+                 fstat(outfile, &o_buff) == 0 && S_ISFIFO(o_buff.st_mode);
+  while (decoded < h.file_size) { // Since we know the number of symbols has to
+                                  // equal the number of bytes of the original
+                                  // file
+    uint32_t cap = IO_BLOCK; // Decode into buff, or straight into a buffer
+    uint8_t *out = buff;     // of our writer Stage, the mapping of outfile or
+    if (output != NULL) {    // pages for the pipe
+      out = stage_get(output, &cap);
+    } else if (dst != NULL) {
+      out = dst + decoded;
+      cap = OUT_SIZE;
+    } else if (gifting) {
+      out = gift_alloc(OUT_SIZE);
+      cap = OUT_SIZE;
+      if (out == NULL) { // Copy them after all
+        out = buff;
+        cap = IO_BLOCK;
+      }
+    }
+    uint32_t want = h.file_size - decoded < cap ? h.file_size - decoded : cap;
+    uint32_t got = dt_decode_bytes(table, &reader, out, want);
+    if (stats) {
+      hist_count(hist, out, got);
+    }
+    int wrote = got; // Bytes of them written
+    if (output != NULL) { // Write the decoded symbols, unless they are
+      stage_put(output, out, got); // in outfile already
+    } else if (dst == NULL && out != buff) {
+      wrote = gift_bytes(outfile, out, cap, got);
+    } else if (dst == NULL) {
+      wrote = write_bytes(outfile, buff, got);
+    }
+    if (wrote != (int)got) {
+      fprintf(stderr, "decode: Couldn't write outfile\n");
+      exit(EXIT_FAILURE); // Exit with non-zero exit code
+    }
+    decoded += got;
+    if (got < want) { // If there are no more codes to read; break
+      break;
+    }
+  }
+  if (dst != NULL) {
+    unmap_output(outfile, dst, h.file_size, decoded);
+  }
+  if (output != NULL && !stage_finish(&output)) {
+    fprintf(stderr, "decode: Couldn't write outfile\n");
+    exit(EXIT_FAILURE); // Exit with non-zero exit code
+  }
+  if (input != NULL && !stage_finish(&input)) {
+    fprintf(stderr, "decode: Couldn't read infile\n");
+    exit(EXIT_FAILURE); // Exit with non-zero exit code
+  }
+  if (decoded < h.file_size) { // We ran out of codes before the end
+    fprintf(stderr, "decode: Corrupt or truncated infile\n");
+    exit(EXIT_FAILURE); // Exit with non-zero exit code
   }
 
   if (stats) { // If our user enabled verbose to print out stats
-    uint64_t comp_size = bytes_read;
-    uint64_t decomp_size = bytes_written;
-    float space_saving = (100 * (1 - ((float)comp_size / decomp_size)));
-    fprintf(stderr,
-            "Compressed file size: %lu bytes\n"
-            "Decompressed file size: %lu bytes\n"
-            "Space saving: %0.2f%s\n",
-            comp_size, decomp_size, space_saving, "%");
-  }
-
-  // Deleteing our huff_tree
-  delete_tree(&huff_tree);
+    report.raw_size = bytes_written;
+    report.comp_size = bytes_read;
+    report.payload_bytes = bytes_read - sizeof(Header) - h.tree_size;
+    stats_codes(&report, hist, lengths);
+    stats_print(&report, 1, stats);
+  }
+
+  // Deleteing our decode table and unmapping infile
+  dt_delete(&table);
+  if (map != NULL) {
+    unmap_input(map, map_size);
+  }
 
   // Closing infile and outfile
   close(infile);
@@ -3,5 +3,51 @@
 #define BLOCK         4096               // 4KB blocks.
 #define ALPHABET      256                // ASCII + Extended ASCII.
 #define MAGIC         0xBEEFBBAD         // 32-bit magic number.
+#define MAGIC_CANON   0xBEEFCAFE         // Magic number for canonical codes.
+#define MAGIC_BLOCKS  0xBEEFB10C         // Magic number for block framing.
+#define MAGIC_ADAPT   0xBEEFADA7         // Magic number for adaptive codes.
+#define MAGIC_SHARED  0xBEEFC0DE         // Magic number for dictionary codes.
+#define MAGIC_DICT    0xBEEFD1C7         // Magic number of a dictionary file.
+#define MAGIC_STORED  0xBEEF57ED         // Magic number for a stored file.
+#define DICT_LIMIT    DT_FLAT_BITS       // Default trained code length limit.
+#define BATCH_SUFFIX  ".huff"            // Suffix of batch mode outputs.
+#define BATCH_OUT     ".out"             // Suffix of batch decodes without it.
+#define BATCH_WRITE   (1 << 30)          // Most bytes per batch mode write.
+#define STAGE_BUFFERS 4                  // Buffers in flight per IO stage.
+#define STAGE_SIZE    (1 << 20)          // Bytes per IO stage buffer.
+#define UNKNOWN_SIZE  UINT64_MAX         // file_size of a streamed input.
 #define MAX_CODE_SIZE (ALPHABET / 8)     // Bytes for a maximum, 256-bit code.
 #define MAX_TREE_SIZE (3 * ALPHABET - 1) // Maximum Huffman tree dump size.
+#define MAX_NODES     (2 * ALPHABET - 1) // Most Nodes in a Huffman tree.
+#define NIL           UINT16_MAX         // Missing child of a tree Node.
+#define AD_NODES      (2 * ALPHABET + 1) // Most Nodes in an adaptive tree.
+#define AD_END        ALPHABET           // Adaptive symbol ending a stream.
+#define AD_FLUSH      (ALPHABET + 1)     // Adaptive symbol ending a byte.
+#define AD_BITS       9                  // Raw bits of a new adaptive symbol.
+#define MAX_LENS_SIZE (2 * ALPHABET)     // Maximum packed code lengths size.
+#ifndef IO_BLOCK
+#define IO_BLOCK      (16 * BLOCK)       // Buffer size for bit IO.
+#endif
+#define DT_ROOT_BITS  10                 // Bits indexed by a decode table.
+#define DT_SUB_BITS   6                  // Bits indexed by a sub-table.
+#define DT_FLAT_BITS  12                 // Longest code with no sub-tables.
+#define MAX_LIMIT     32                 // Longest code length limit.
+#define BLOCK_SIZE    (1 << 20)          // Default 1MB framed blocks.
+#define STREAM_BLOCK  (1 << 16)          // Default 64KB streamed blocks.
+#define MAX_BLOCK     (1 << 26)          // Largest framed block, 64MB.
+#define BLOCK_HUFFMAN 0                  // Block of canonical Huffman codes.
+#define BLOCK_END     255                // Last block, holds the block index.
+#define STREAMS       4                  // Default bitstreams per block.
+#define MAX_STREAMS   16                 // Most bitstreams per block.
+#define BLOCK_CONTEXT 1                  // Block of order-1 context codes.
+#define BLOCK_STORED  2                  // Block of raw, uncoded bytes.
+#define COPY_SIZE     (1 << 30)          // Most bytes per copy_file_range.
+#define OUT_SIZE      (1 << 20)          // Bytes decoded per mapped chunk.
+#define SAMPLE_SEED   0x9E3779B97F4A7C15 // Seed of the offsets of samples.
+#define CTX_TABLES    16                 // Most code tables per block.
+#define CTX_ROUNDS    4                  // Rounds of context clustering.
+#define CTX_MIN_BYTES 8192               // Block bytes per context table.
+#define MAX_TABLES    ((CTX_TABLES + 1) * MAX_LENS_SIZE) // Most table bytes.
+#define MAX_PHASES    8                  // Most phases timed for -v.
+#define STATS_TEXT    1                  // -v prints stats as text.
+#define STATS_JSON    2                  // --stats=json prints them as JSON.
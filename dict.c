@@ -0,0 +1,91 @@
+// clang-format off
+#include "dict.h"		// Dictionary header file
+#include "huffman.h"	// Huffman header file
+#include "header.h"		// Headers header file
+#include "code.h"		// Code header file
+#include "io.h"			// IO header file
+#include "defines.h"	// Defines header file
+
+#include <stdint.h>		// Declares more integer types
+#include <string.h>		// Used for memcpy
+// clang-format on
+
+// A dictionary holds canonical code lengths trained on a sample corpus, so
+// small files that look like the corpus can be coded without a histogram
+// pass, a tree or a code table of their own. Files coded with one (magic
+// MAGIC_SHARED) only carry its id after their Header. A dictionary file is a
+// DictHeader followed by table_size bytes of packed code lengths.
+
+// dict_id : Helper function that returns the id of the code lengths of a
+// dictionary, their 32-bit FNV-1a hash
+static uint32_t dict_id(uint8_t lengths[static ALPHABET]) {
+  uint32_t hash = 2166136261U;
+  for (int i = 0; i < ALPHABET; i += 1) {
+    hash = (hash ^ lengths[i]) * 16777619U;
+  }
+  return hash;
+}
+
+// dict_train : Function that trains a dictionary on the symbols counted in
+// hist, with codes of at most limit bits. Every symbol gets a code, even
+// ones the corpus lacks, so any file can be coded with it. Returns FALSE/0
+// if error.
+bool dict_train(uint64_t hist[static ALPHABET], uint32_t limit,
+                Dictionary *d) {
+  uint64_t counts[ALPHABET];
+  for (int i = 0; i < ALPHABET; i += 1) {
+    counts[i] = hist[i] + 1;
+  }
+  if (!build_limited_lengths(counts, limit, d->lengths)) {
+    return 0;
+  }
+  d->id = dict_id(d->lengths);
+  return 1;
+}
+
+// dict_codes : Function that fills table with the canonical codes of a
+// dictionary. Returns FALSE/0 if its code lengths are not a valid code.
+bool dict_codes(Dictionary *d, Code table[static ALPHABET]) {
+  for (int i = 0; i < ALPHABET; i += 1) {
+    table[i] = code_init();
+  }
+  return canonical_codes(d->lengths, table);
+}
+
+// dict_save : Function that writes a dictionary to outfile. Returns FALSE/0
+// if error.
+bool dict_save(int outfile, Dictionary *d) {
+  uint8_t packed[MAX_LENS_SIZE];
+  DictHeader dh;
+  dh.magic = MAGIC_DICT;
+  dh.id = d->id;
+  dh.table_size = pack_lengths(d->lengths, packed);
+  return write_bytes(outfile, (uint8_t *)&dh, sizeof(dh)) == sizeof(dh) &&
+         write_bytes(outfile, packed, dh.table_size) == (int)dh.table_size;
+}
+
+// dict_load : Function that reads a dictionary from infile, a regular file.
+// Returns FALSE/0 if it is not a dictionary or is corrupt.
+bool dict_load(int infile, Dictionary *d) {
+  uint64_t size = 0;
+  uint8_t *map = map_input(infile, &size);
+  if (map == NULL) {
+    return 0;
+  }
+  DictHeader dh;
+  Code codes[ALPHABET];
+  bool ok = size >= sizeof(dh);
+  if (ok) {
+    memcpy(&dh, map, sizeof(dh));
+    ok = dh.magic == MAGIC_DICT && dh.table_size <= MAX_LENS_SIZE &&
+         size - sizeof(dh) >= dh.table_size &&
+         unpack_lengths(dh.table_size, map + sizeof(dh), d->lengths) &&
+         dict_codes(d, codes);
+  }
+  unmap_input(map, size);
+  for (int i = 0; ok && i < ALPHABET; i += 1) {
+    ok = d->lengths[i] > 0; // Every symbol must have a code
+  }
+  d->id = dict_id(d->lengths);
+  return ok && d->id == dh.id;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "code.h"
+#include "defines.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t id;               // Names the dictionary in a Header
+    uint8_t lengths[ALPHABET]; // Code length of every symbol
+} Dictionary;
+
+bool dict_train(uint64_t hist[static ALPHABET], uint32_t limit,
+                Dictionary *d);
+
+bool dict_codes(Dictionary *d, Code table[static ALPHABET]);
+
+bool dict_save(int outfile, Dictionary *d);
+
+bool dict_load(int infile, Dictionary *d);
@@ -4,8 +4,17 @@
 #include "code.h"	      // Code header file
 #include "defines.h"	  // Defines Header File
 #include "header.h"	    // Headers Header File
+#include "block.h"	    // Block Header File
+#include "hist.h"	      // Histogram Header File
+#include "stats.h"	    // Stats Header File
+#include "adaptive.h"	  // Adaptive Header File
+#include "dict.h"	      // Dictionary Header File
+#include "batch.h"	    // Batch Header File
+#include "stage.h"	    // Stage Header File
 
 #include <fcntl.h>	    // Used for file functions
+#include <getopt.h>	    // Used for long options
+#include <string.h>	    // Used for memcpy and strcmp
 #include <sys/stat.h>	  // Used for getting permission bits
 #include <stdint.h>	    // Declares more integer types
 #include <stdio.h>	    // Used for input and output for our program
@@ -13,7 +22,11 @@
 #include <unistd.h>	    // Used for types and functions for our program
 // clang-format on
 
-#define OPTIONS "hi:o:v" // Valid User commands
+#define OPTIONS "hi:o:vcl:b:t:n:sxaD:Pp:B" // Valid User commands
+
+// Valid long User commands
+static struct option long_options[] = {{"stats", required_argument, 0, 'S'},
+                                       {0, 0, 0, 0}};
 
 // help : Help message that displayes program synopsis and usage; prints to
 // stderr
@@ -23,25 +36,156 @@ void help(void) { // Help message that displayes program synopsis and usage
                   "  Compresses a file using the Huffman coding algorithm.\n"
                   "\n"
                   "USAGE\n"
-                  "  ./encode [-h] [-i infile] [-o outfile]\n"
+                  "  ./encode [-h] [-v] [-c] [-l bits] [-b size] [-t threads]\n"
+                  "           [-n streams] [-s] [-x] [-a] [-D dict] [-P]\n"
+                  "           [-p percent] [--stats=format]\n"
+                  "           [-i infile] [-o outfile] [-B [file ...]]\n"
                   "\n"
                   "OPTIONS\n"
                   "  -h             Program usage and help.\n"
                   "  -v             Print compression statistics.\n"
+                  "  --stats=format Print them as text or json.\n"
+                  "  -c             Use canonical codes and store only their\n"
+                  "                 lengths instead of the tree.\n"
+                  "  -l bits        Limit codes to at most bits bits (8-32).\n"
+                  "                 Implies -c.\n"
+                  "  -b size        Code independent blocks of size bytes\n"
+                  "                 (suffix K or M, default 1M).\n"
+                  "  -t threads     Code blocks on threads threads. Implies -b.\n"
+                  "                 With -B, code files on threads threads\n"
+                  "                 (default every core).\n"
+                  "  -n streams     Cut every block into streams interleaved\n"
+                  "                 bitstreams (1-16, default 4). Implies -b.\n"
+                  "  -s             Stream: code blocks as input arrives, with\n"
+                  "                 no temp file (default size 64K). Implies -b.\n"
+                  "  -x             Context: code each byte with a table picked\n"
+                  "                 by the byte before it. Implies -b.\n"
+                  "  -a             Adaptive: one pass codes that learn as they\n"
+                  "                 go, sent as soon as input arrives, with no\n"
+                  "                 tree and no blocks.\n"
+                  "  -D dict        Code with the shared codes of a dictionary\n"
+                  "                 made by train, skipping the tree (and,\n"
+                  "                 for stdin, the histogram). Not with -b\n"
+                  "                 or -a.\n"
+                  "  -P             Pipeline: read and write ahead while\n"
+                  "                 coding, on io_uring for files or threads\n"
+                  "                 of their own otherwise, instead of\n"
+                  "                 mapping infile. Not with -b or -a.\n"
+                  "  -p percent     Sample: build codes from percent (1-99)\n"
+                  "                 percent of infile, read in blocks spread\n"
+                  "                 across it. Bytes it misses still get\n"
+                  "                 codes; -v prints what it costs. Not with\n"
+                  "                 -b, -a or -D.\n"
                   "  -i infile      Input file to compress.\n"
-                  "  -o outfile     Output of compressed data.\n");
+                  "  -o outfile     Output of compressed data.\n"
+                  "  -B [file ...]  Batch: code every file named, or listed\n"
+                  "                 one per line on stdin, to file.huff in one\n"
+                  "                 process. Takes -b, -l, -t and -v only.\n");
   return;
 }
 
+// parse_size : Function that parses a size in bytes with an optional K or M
+// suffix. Returns 0 if str is not a size.
+uint64_t parse_size(char *str) {
+  char *end;
+  uint64_t size = strtoull(str, &end, 10);
+  if (*end == 'K' || *end == 'k') {
+    size <<= 10;
+    end += 1;
+  } else if (*end == 'M' || *end == 'm') {
+    size <<= 20;
+    end += 1;
+  }
+  return *end == '\0' ? size : 0;
+}
+
+// next_chunk : Function that points *chunk at the next bytes of infile and
+// returns how many there are, 0 at the end. Mapped input is handed out in
+// place, all at once; with a reader Stage, the buffers it read ahead are
+// handed out one by one, each given back on the next call (a failed read
+// ends them early; see stage_finish); anything else is read into buff
+// IO_BLOCK at a time, and a failed read exits.
+uint64_t next_chunk(int infile, uint8_t *map, uint64_t map_size,
+                    uint64_t *offset, uint8_t *buff, uint8_t **chunk,
+                    Stage *stage) {
+  if (stage != NULL) {
+    if (*chunk != NULL) {
+      stage_put(stage, *chunk, 0);
+    }
+    uint32_t n = 0;
+    *chunk = stage_get(stage, &n);
+    return n;
+  }
+  if (map != NULL) {
+    uint64_t n = map_size - *offset; // Everything we have not handed out
+    *chunk = map + *offset;
+    *offset = map_size;
+    bytes_read += n; // Count mapped bytes as read to keep our stats right
+    return n;
+  }
+  *chunk = buff;
+  int n = read_bytes(infile, buff, IO_BLOCK);
+  if (n < 0) {
+    fprintf(stderr, "encode: Couldn't read infile\n");
+    exit(EXIT_FAILURE); // Exit with non-zero exit code
+  }
+  return n;
+}
+
+// sample_hist : Function that fills hist from about percent percent of the
+// size bytes of infile: IO_BLOCK bytes from a random offset within each of
+// a run of equal strides across it, read with pread() so the rest is never
+// read. The offsets come from a fixed seed, so the same infile always gets
+// the same codes. Returns the number of bytes sampled.
+uint64_t sample_hist(int infile, uint64_t size, uint32_t percent,
+                     uint8_t *buff, uint64_t hist[static ALPHABET]) {
+  uint64_t blocks = (size * percent / 100 + IO_BLOCK - 1) / IO_BLOCK;
+  blocks = blocks ? blocks : 1;
+  uint64_t stride = size / blocks;
+  uint64_t seed = SAMPLE_SEED;
+  uint64_t sampled = 0;
+  for (uint64_t i = 0; i < blocks; i += 1) {
+    uint64_t offset = i * stride;
+    if (stride > IO_BLOCK) { // Anywhere in the stride, by xorshift
+      seed ^= seed << 13;
+      seed ^= seed >> 7;
+      seed ^= seed << 17;
+      offset += seed % (stride - IO_BLOCK + 1);
+    }
+    int n = read_at(infile, buff, IO_BLOCK, offset);
+    hist_count(hist, buff, n);
+    sampled += n;
+  }
+  return sampled;
+}
+
 // main : main function for encode
 int main(int argc, char **argv) {
   int opt = 0;                 // Used to store the current user input
   int infile = STDIN_FILENO;   // Used to store the input file to encode
   int outfile = STDOUT_FILENO; // Used to store the output file to encode
-  bool stats = 0; // Used to indicate if the user wants to print out the
-                  // compression stats
+  uint8_t stats = 0; // Used to indicate if and how the user wants to print
+                     // out the compression stats
+  bool canon = 0; // Used to indicate if the user wants canonical codes
+  uint32_t limit = 0; // Longest code length allowed; 0 for no limit
+  uint64_t block_size = 0;    // Size of framed blocks; 0 for a single stream
+  uint32_t threads = 0;       // Number of threads coding blocks; 0 for
+                              // the default
+  uint32_t streams = STREAMS; // Number of bitstreams per block
+  bool stream = 0;            // Used to indicate if the user wants small
+                              // blocks streamed straight through
+  uint8_t model = BLOCK_HUFFMAN; // Type of blocks to code
+  bool adaptive = 0;          // Used to indicate if the user wants adaptive
+                              // codes
+  Dictionary dict;            // Shared codes from a dictionary
+  bool shared = 0;            // Used to indicate if the user gave one
+  bool batch = 0;             // Used to indicate if the user wants batch mode
+  bool pipelined = 0;         // Used to indicate if the user wants IO on
+                              // threads of its own
+  uint32_t sample = 0;        // Percent of infile codes are built from; 0
+                              // for all of it
 
-  while ((opt = getopt(argc, argv, OPTIONS)) !=
+  while ((opt = getopt_long(argc, argv, OPTIONS, long_options, NULL)) !=
          -1) {     // Go in a loop to handle users input(s)
     switch (opt) { // Use switch to handle users input
     case 'i':      // User wants to specify the input file to encode
@@ -65,7 +209,112 @@ int main(int argc, char **argv) {
       break; // Break; ensures we only go through this case
 
     case 'v': // User wants to print out the compression stats after program
-      stats = 1;
+      stats = STATS_TEXT;
+      break; // Break; ensures we only go through this case
+
+    case 'S': // User wants the compression stats in a given format
+      if (strcmp(optarg, "json") == 0) {
+        stats = STATS_JSON;
+      } else if (strcmp(optarg, "text") == 0) {
+        stats = STATS_TEXT;
+      } else {
+        fprintf(stderr, "encode: Stats format must be text or json\n");
+        help();             // Print the programs synopsis and usage
+        exit(EXIT_FAILURE); // Exit with non-zero exit code
+      }
+      break; // Break; ensures we only go through this case
+
+    case 'c': // User wants canonical codes with a code length header
+      canon = 1;
+      break; // Break; ensures we only go through this case
+
+    case 'l': // User wants to limit the length of our codes
+      limit = strtoul(optarg, NULL, 10);
+      if (limit < 8 || limit > MAX_LIMIT) { // 8 bits always fit 256 symbols
+        fprintf(stderr, "encode: Code length limit must be 8 to %d bits\n",
+                MAX_LIMIT);
+        help();             // Print the programs synopsis and usage
+        exit(EXIT_FAILURE); // Exit with non-zero exit code
+      }
+      canon = 1; // Limited codes are only stored as code lengths
+      break;     // Break; ensures we only go through this case
+
+    case 'b': // User wants to code independent blocks
+      block_size = parse_size(optarg);
+      if (block_size < BLOCK || block_size > MAX_BLOCK) {
+        fprintf(stderr, "encode: Block size must be %dK to %dM\n",
+                BLOCK >> 10, MAX_BLOCK >> 20);
+        help();             // Print the programs synopsis and usage
+        exit(EXIT_FAILURE); // Exit with non-zero exit code
+      }
+      break; // Break; ensures we only go through this case
+
+    case 't': // User wants to code blocks on several threads
+      threads = strtoul(optarg, NULL, 10);
+      if (threads < 1) {
+        fprintf(stderr, "encode: Need at least 1 thread\n");
+        help();             // Print the programs synopsis and usage
+        exit(EXIT_FAILURE); // Exit with non-zero exit code
+      }
+      if (block_size == 0) {
+        block_size = BLOCK_SIZE;
+      }
+      break; // Break; ensures we only go through this case
+
+    case 'n': // User wants a number of bitstreams per block
+      streams = strtoul(optarg, NULL, 10);
+      if (streams < 1 || streams > MAX_STREAMS) {
+        fprintf(stderr, "encode: Streams must be between 1 and %d\n",
+                MAX_STREAMS);
+        help();             // Print the programs synopsis and usage
+        exit(EXIT_FAILURE); // Exit with non-zero exit code
+      }
+      if (block_size == 0) {
+        block_size = BLOCK_SIZE;
+      }
+      break; // Break; ensures we only go through this case
+
+    case 's': // User wants to stream blocks through a pipeline
+      stream = 1;
+      break; // Break; ensures we only go through this case
+
+    case 'x': // User wants order-1 context tables in every block
+      model = BLOCK_CONTEXT;
+      if (block_size == 0) {
+        block_size = BLOCK_SIZE;
+      }
+      break; // Break; ensures we only go through this case
+
+    case 'D': { // User wants the shared codes of a dictionary
+      int dictfile = open(optarg, O_RDONLY);
+      if (dictfile < 0 || !dict_load(dictfile, &dict)) {
+        fprintf(stderr, "encode: Couldn't load dictionary %s\n", optarg);
+        exit(EXIT_FAILURE); // Exit with non-zero exit code
+      }
+      close(dictfile);
+      shared = 1;
+      break; // Break; ensures we only go through this case
+    }
+
+    case 'P': // User wants reading, coding and writing to overlap
+      pipelined = 1;
+      break; // Break; ensures we only go through this case
+
+    case 'p': // User wants codes built from a sample of infile
+      sample = strtoul(optarg, NULL, 10);
+      if (sample < 1 || sample > 99) {
+        fprintf(stderr, "encode: Sample must be 1 to 99 percent\n");
+        help();             // Print the programs synopsis and usage
+        exit(EXIT_FAILURE); // Exit with non-zero exit code
+      }
+      break; // Break; ensures we only go through this case
+
+    case 'B': // User wants to code many files in one process
+      batch = 1;
+      break; // Break; ensures we only go through this case
+
+    case 'a': // User wants one pass adaptive codes
+      adaptive = 1;
       break; // Break; ensures we only go through this case
 
     case 'h':             // Displays program synopsis and usage
@@ -80,23 +329,166 @@ int main(int argc, char **argv) {
     }
   }
 
+  if (batch) { // Batch mode: every file is coded on its own on a pool
+    if (shared || adaptive || pipelined || sample || (canon && limit == 0) ||
+        stream ||
+        model != BLOCK_HUFFMAN || streams != STREAMS ||
+        infile != STDIN_FILENO || outfile != STDOUT_FILENO) {
+      fprintf(stderr, "encode: -B only takes -b, -l, -t and -v\n");
+      help();             // Print the programs synopsis and usage
+      exit(EXIT_FAILURE); // Exit with non-zero exit code
+    }
+    uint32_t count = argc - optind;
+    char **paths = argv + optind;
+    if (count == 0) { // No files named, so they are listed on stdin
+      paths = batch_list(stdin, &count);
+      if (paths == NULL) {
+        fprintf(stderr, "encode: Couldn't read file list\n");
+        exit(EXIT_FAILURE); // Exit with non-zero exit code
+      }
+    }
+    Stats report;
+    stats_init(&report);
+    stats_phase(&report, "batch");
+    bool ok = batch_encode(paths, count, block_size, limit,
+                           threads ? threads : sysconf(_SC_NPROCESSORS_ONLN),
+                           stats ? &report : NULL);
+    if (stats) { // If our user enabled verbose to print out stats
+      stats_print(&report, 0, stats);
+    }
+    exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  if ((shared || pipelined) && (block_size || adaptive)) {
+    fprintf(stderr, "encode: -D and -P can't be used with -b or -a\n");
+    help();             // Print the programs synopsis and usage
+    exit(EXIT_FAILURE); // Exit with non-zero exit code
+  }
+
+  if (sample && (shared || block_size || adaptive)) {
+    fprintf(stderr, "encode: -p can't be used with -b, -a or -D\n");
+    help();             // Print the programs synopsis and usage
+    exit(EXIT_FAILURE); // Exit with non-zero exit code
+  }
+
+  if (stream && block_size == 0) { // Small blocks keep the first output byte
+    block_size = STREAM_BLOCK;      // close to the first input byte
+  }
+
+  // Collecting stats as we go, phase by phase
+  Stats report;
+  stats_init(&report);
+
+  // Getting permission bits and size of infile
+  struct stat s_buff;
+  fstat(infile, &s_buff);
+
+  if (adaptive) { // Adaptive mode: every byte is coded as soon as it is read
+                  // with codes learned from the bytes before it
+    fchmod(outfile, s_buff.st_mode); // Set same permissions to outfile
+    Header h;
+    h.magic = MAGIC_ADAPT;
+    h.permissions = s_buff.st_mode;
+    h.tree_size = 0; // No tree, the decoder learns the same codes
+    h.file_size = S_ISREG(s_buff.st_mode) ? (uint64_t)s_buff.st_size
+                                          : UNKNOWN_SIZE; // Pipes have no size
+    write_bytes(outfile, (uint8_t *)&h, sizeof(h));
+    stats_phase(&report, "adaptive");
+    Adaptive *tree = ad_create();
+    if (tree == NULL) {
+      fprintf(stderr, "encode: Couldn't create adaptive tree\n");
+      exit(EXIT_FAILURE); // Exit with non-zero exit code
+    }
+    uint8_t buff[IO_BLOCK]; // Buffer for reading infile a chunk at a time
+    uint8_t bits[IO_BLOCK]; // Buffer our bit writer fills before writing
+    BitWriter writer;
+    bw_init(&writer, outfile, bits, IO_BLOCK);
+    int n = 0; // Number of bytes in buff
+    while ((n = read_some(infile, buff, IO_BLOCK)) > 0) {
+      for (int i = 0; i < n; i += 1) {
+        uint32_t len = ad_encode(tree, &writer, buff[i]);
+        if (stats) {
+          report.hist[buff[i]] += 1;
+          report.code_bits += len;
+          report.max_len = len > report.max_len ? len : report.max_len;
+        }
+      }
+      ad_flush(tree, &writer); // Hand out every symbol so far before waiting
+      bw_sync(&writer);        // on more input
+    }
+    if (n < 0) {
+      fprintf(stderr, "encode: Couldn't read infile\n");
+      exit(EXIT_FAILURE); // Exit with non-zero exit code
+    }
+    ad_encode(tree, &writer, AD_END);
+    bw_flush(&writer);
+    ad_delete(&tree);
+    if (stats) { // If our user enabled verbose to print out stats
+      report.raw_size = bytes_read;
+      report.comp_size = bytes_written;
+      report.payload_bytes = bytes_written - sizeof(Header);
+      stats_print(&report, 0, stats);
+    }
+    close(infile);
+    close(outfile);
+    exit(EXIT_SUCCESS); // Exits indicating a successful termination
+  }
+
+  if (block_size) { // Framed mode: blocks are coded as they are read, so
+                    // infile is streamed in one pass without a temp file
+    fchmod(outfile, s_buff.st_mode); // Set same permissions to outfile
+    Header h;
+    h.magic = MAGIC_BLOCKS;
+    h.permissions = s_buff.st_mode;
+    h.tree_size = 0; // Every block carries its own code lengths
+    h.file_size = S_ISREG(s_buff.st_mode) ? (uint64_t)s_buff.st_size
+                                          : UNKNOWN_SIZE; // Pipes have no size
+    if (write_bytes(outfile, (uint8_t *)&h, sizeof(h)) != sizeof(h)) {
+      fprintf(stderr, "encode: Couldn't write outfile\n");
+      exit(EXIT_FAILURE); // Exit with non-zero exit code
+    }
+    stats_phase(&report, "blocks"); // Reading, coding and writing overlap
+    if (!encode_blocks(infile, outfile, block_size, limit ? limit : MAX_LIMIT,
+                       streams, model, threads ? threads : 1,
+                       stats ? &report : NULL)) {
+      fprintf(stderr, "encode: Couldn't encode or write blocks\n");
+      exit(EXIT_FAILURE); // Exit with non-zero exit code
+    }
+    if (stats) { // If our user enabled verbose to print out stats
+      report.raw_size = bytes_read;
+      report.comp_size = bytes_written;
+      stats_print(&report, 0, stats);
+    }
+    close(infile);
+    close(outfile);
+    exit(EXIT_SUCCESS); // Exits indicating a successful termination
+  }
+
   // Creating our histogram
-  uint64_t hist[ALPHABET];
+  uint64_t hist[ALPHABET] = {0};
 
   // If input comes from stdin, we will put input into a temp file first
-  uint8_t buff = '\0';
+  uint8_t buff[IO_BLOCK]; // Buffer for reading infile a chunk at a time
+  int n = 0;           // Number of bytes in buff
+  // Shared codes need no histogram, so then it is only filled for our stats
+  // or, for a file of our user's, to tell if the codes pay off at all
+  bool counting = !shared || stats || infile != STDIN_FILENO;
   if (infile == STDIN_FILENO) {
+    stats_phase(&report, "spool");
     FILE *temp_file =
         tmpfile(); // Referenced :
                    // https://www.tutorialspoint.com/c_standard_library/c_function_tmpfile.htm
     int temp = fileno(
         temp_file); // Referenced :
                     // https://man7.org/linux/man-pages/man3/fileno.3.html
-    while (read_bytes(infile, &buff, 1) > 0) {
-      write_bytes(temp, &buff, 1);
+    while ((n = read_bytes(infile, buff, IO_BLOCK)) > 0) {
+      write_bytes(temp, buff, n);
     }
-    free(temp_file);
-    infile = temp;
+    if (n < 0) {
+      fprintf(stderr, "encode: Couldn't read infile\n");
+      exit(EXIT_FAILURE); // Exit with non-zero exit code
+    }
+    infile = temp; // temp_file stays open; its descriptor is now our infile
   }
   // Reset stats
   bytes_read = 0;
@@ -105,28 +497,64 @@ int main(int argc, char **argv) {
   // Starting at the beginning of infile
   lseek(infile, 0, SEEK_SET);
 
-  int uniq_sym = 0; // Unique symbol counter
+  // Regular files (our temp file included) are mapped, so both passes run
+  // straight over memory and the second one is served from the page cache.
+  // Pipelined, infile is read by a reader Stage instead, so its reads (and
+  // not page faults) overlap our work.
+  uint64_t map_size = 0;
+  uint8_t *map = pipelined ? NULL : map_input(infile, &map_size);
+  uint8_t *chunk = NULL; // Next bytes of infile
+  uint64_t len = 0;      // Number of bytes in chunk
+  uint64_t offset = 0;   // Bytes of the mapping handed out so far
+  Stage *reader = NULL;  // Reads infile ahead of us when pipelined
 
-  // Reading our infile to fill our histogram
-  while (read_bytes(infile, &buff, 1) > 0) {
-    if (hist[buff] == 0) { // Increment unique symbol counter
-      uniq_sym += 1;
+  // Reading our infile to fill our histogram, if we need one
+  stats_phase(&report, "histogram");
+  if (pipelined && counting && !sample) {
+    reader = stage_create(infile, 0);
+  }
+  while (counting && !sample &&
+         (len = next_chunk(infile, map, map_size, &offset, buff, &chunk,
+                           reader)) > 0) {
+    hist_count(hist, chunk, len);
+    report.raw_size += len;
+  }
+  if (reader != NULL && !stage_finish(&reader)) {
+    fprintf(stderr, "encode: Couldn't read infile\n");
+    exit(EXIT_FAILURE); // Exit with non-zero exit code
+  }
+  uint64_t sampled = report.raw_size; // Bytes our histogram was filled from
+  if (sample) { // Only blocks spread across infile are read
+    fstat(infile, &s_buff);
+    report.raw_size = s_buff.st_size;
+    sampled = sample_hist(infile, report.raw_size, sample, buff, hist);
+    report.sampled = sampled;
+  }
+  uint64_t counts[ALPHABET]; // Our histogram before any symbols are forced
+  memcpy(counts, hist, sizeof(hist));
+
+  // Bytes our sample missed may still be in infile, so every byte gets at
+  // least the smallest count, and with it a code
+  for (int i = 0; sample && i < ALPHABET; i += 1) {
+    if (hist[i] == 0) {
+      hist[i] = 1;
     }
-    hist[buff] += 1; // Increment histogram
   }
 
   // Setting the first two symbols (if not set)
   if (hist[0] == 0) {
-    uniq_sym += 1; // Increment unique symbol counter
-    hist[0] = 1;   // Increment histogram
+    hist[0] = 1; // Increment histogram
   }
   if (hist[1] == 0) {
-    uniq_sym += 1; // Increment unique symbol counter
-    hist[1] = 1;   // Increment histogram
+    hist[1] = 1; // Increment histogram
   }
 
-  // Build our Huffman Tree
-  Node *huff_tree = build_tree(hist);
+  // Build our Huffman Tree; limited codes come straight from the histogram
+  stats_phase(&report, "codes");
+  Tree huff_tree;
+  if (!limit && !shared) {
+    build_tree(hist, &huff_tree);
+  }
 
   // Creating our Code Table
   Code code_table[ALPHABET];
@@ -136,58 +564,171 @@ int main(int argc, char **argv) {
   }
 
   // Filling up our Code Table
-  build_codes(huff_tree, code_table);
+  uint8_t lengths[ALPHABET];   // Code lengths for canonical codes
+  uint8_t packed[MAX_TREE_SIZE]; // Packed code lengths or dumped tree
+  uint16_t packed_size = 0;      // written to outfile
+  if (shared) { // Codes come from the dictionary, named by its id
+    dict_codes(&dict, code_table);
+    memcpy(packed, &dict.id, sizeof(dict.id));
+    packed_size = sizeof(dict.id);
+  } else if (canon) { // Only the code lengths come from our tree
+    if (limit) {
+      build_limited_lengths(hist, limit, lengths);
+    } else {
+      build_lengths(&huff_tree, lengths);
+    }
+    canonical_codes(lengths, code_table);
+    packed_size = pack_lengths(lengths, packed);
+  } else {
+    build_codes(&huff_tree, code_table);
+    packed_size = dump_tree(&huff_tree, packed);
+  }
+
+  // Input that is already compressed or random doesn't get any smaller, so
+  // if its codes and their table add up to no less than infile, infile is
+  // stored as it is instead, which also skips coding it. Shared codes for
+  // stdin have no histogram to tell, so they are always used.
+  uint64_t coded_bits = 0; // Size of infile in our codes, scaled up from
+  for (int i = 0; i < ALPHABET; i += 1) { // our sample if we took one
+    coded_bits += counts[i] * code_size(&code_table[i]);
+  }
+  if (sampled < report.raw_size) {
+    coded_bits = (double)coded_bits * report.raw_size / (sampled ? sampled : 1);
+  }
+  bool stored =
+      counting && packed_size + (coded_bits + 7) / 8 >= report.raw_size;
+  if (stored) {
+    packed_size = 0; // No table
+  }
 
   // Building our Header
   Header h;
   // Setting magic number field
-  h.magic = MAGIC;
+  h.magic = stored   ? MAGIC_STORED
+            : shared ? MAGIC_SHARED
+            : canon  ? MAGIC_CANON
+                     : MAGIC;
   // Getting permission bits of infile
-  struct stat s_buff;
   fstat(infile, &s_buff);
   // Setting permissions
   h.permissions = s_buff.st_mode;
   // Set same permissions to outfile
   fchmod(outfile, h.permissions);
-  // Setting tree_size
-  h.tree_size = ((3 * uniq_sym) - 1);
+  // Setting tree_size; the size of the dumped tree, packed lengths or
+  // dictionary id
+  h.tree_size = packed_size;
   // Setting file_size
   h.file_size = s_buff.st_size;
 
   // Writing our header to outfile
   write_bytes(outfile, (uint8_t *)&h, sizeof(h));
 
-  // Writing our our huffman tree to outfile
-  dump_tree(outfile, huff_tree);
+  // Writing our our huffman tree (or its code lengths) to outfile
+  write_bytes(outfile, packed, packed_size);
 
   // Starting at the beginning of infile
   lseek(infile, 0, SEEK_SET);
+  offset = 0;
+  chunk = NULL;
 
-  // Reset our buffer
-  buff = '\0';
+  if (stored) { // Copying infile as it is, in the kernel where we can
+    stats_phase(&report, "store");
+    if (copy_bytes(infile, outfile, h.file_size) != h.file_size) {
+      fprintf(stderr, "encode: Couldn't copy infile\n");
+      exit(EXIT_FAILURE); // Exit with non-zero exit code
+    }
+    if (stats) { // If our user enabled verbose to print out stats
+      uint8_t raw_bits[ALPHABET]; // Every byte takes its own 8 bits
+      memset(raw_bits, 8, ALPHABET);
+      stats_codes(&report, counts, raw_bits);
+      report.comp_size = bytes_written;
+      report.payload_bytes = h.file_size;
+      stats_print(&report, 0, stats);
+    }
+    if (map != NULL) {
+      unmap_input(map, map_size);
+    }
+    close(infile);
+    close(outfile);
+    exit(EXIT_SUCCESS); // Exits indicating a successful termination
+  }
+
+  // Codes that fit in a machine word are written straight from a word
+  uint32_t code_words[ALPHABET];
+  uint8_t code_bits[ALPHABET];
+  bool word_codes = 1;
+  for (int i = 0; i < ALPHABET; i += 1) {
+    code_words[i] = code_word(&code_table[i]);
+    code_bits[i] = code_size(&code_table[i]);
+    if (code_bits[i] > 32) {
+      word_codes = 0;
+    }
+  }
 
   // Writing each code for each symbol to outfile from infile
-  while (read_bytes(infile, &buff, 1) > 0) {
-    write_code(outfile, &code_table[buff]);
+  stats_phase(&report, "encode");
+  uint64_t full[ALPHABET] = {0}; // Histogram of all of infile, if sampled
+  uint8_t bits[IO_BLOCK]; // Buffer our bit writer collects codes in
+  BitWriter writer;
+  Stage *output = NULL; // Writes our codes out behind us when pipelined
+  if (pipelined) {
+    reader = stage_create(infile, 0);
+    output = stage_create(outfile, 1);
+  }
+  if (output != NULL) {
+    bw_init_stage(&writer, output);
+  } else {
+    bw_init(&writer, outfile, bits, IO_BLOCK);
+  }
+  while ((len = next_chunk(infile, map, map_size, &offset, buff, &chunk,
+                           reader)) > 0) {
+    if (stats && sample) { // To tell what our sample cost
+      hist_count(full, chunk, len);
+    }
+    for (uint64_t i = 0; i < len; i += 1) {
+      if (word_codes) {
+        bw_write_bits(&writer, code_words[chunk[i]], code_bits[chunk[i]]);
+      } else {
+        bw_write_code(&writer, &code_table[chunk[i]]);
+      }
+    }
   }
 
   // Flush remaining codes
-  flush_codes(outfile);
+  bw_flush(&writer);
+  if (reader != NULL && !stage_finish(&reader)) {
+    fprintf(stderr, "encode: Couldn't read infile\n");
+    exit(EXIT_FAILURE); // Exit with non-zero exit code
+  }
+  if (output != NULL && !stage_finish(&output)) {
+    fprintf(stderr, "encode: Couldn't write outfile\n");
+    exit(EXIT_FAILURE); // Exit with non-zero exit code
+  }
 
   if (stats) { // If our user enabled verbose to print out stats
-    uint64_t comp_size = bytes_written;
-    uint64_t uncomp_size =
-        bytes_read / 2; // Take half because we read through the file twice
-    float space_saving = (100 * (1 - ((float)comp_size / uncomp_size)));
-    fprintf(stderr,
-            "Uncompressed file size: %lu bytes\n"
-            "Compressed file size: %lu bytes\n"
-            "Space saving: %0.2f%s\n",
-            uncomp_size, comp_size, space_saving, "%");
-  }
-
-  // Deleteing our huff_tree
-  delete_tree(&huff_tree);
+    report.comp_size = bytes_written;
+    report.payload_bytes = bytes_written - sizeof(Header) - packed_size;
+    stats_codes(&report, sample ? full : counts, code_bits);
+  }
+  uint8_t best[ALPHABET]; // Codes we would have built from all of infile
+  if (stats && sample && build_limited_lengths(full, MAX_LIMIT, best)) {
+    uint64_t best_bits = 0;
+    for (int i = 0; i < ALPHABET; i += 1) {
+      best_bits += full[i] * best[i];
+    }
+    uint8_t packed_best[MAX_LENS_SIZE];
+    report.penalty = (int64_t)report.payload_bytes + packed_size -
+                     (int64_t)((best_bits + 7) / 8) -
+                     pack_lengths(best, packed_best);
+  }
+  if (stats) {
+    stats_print(&report, 0, stats);
+  }
+
+  // Unmapping infile
+  if (map != NULL) {
+    unmap_input(map, map_size);
+  }
 
   // Closing infile and outfile
   close(infile);
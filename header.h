@@ -8,3 +8,27 @@ typedef struct {
     uint16_t tree_size;
     uint64_t file_size;
 } Header;
+
+typedef struct {
+    uint32_t raw_size;
+    uint32_t comp_size;
+    uint16_t table_size;
+    uint8_t type;
+    uint8_t streams;
+} BlockHeader;
+
+typedef struct {
+    uint64_t raw_offset;
+    uint64_t comp_offset;
+} IndexEntry;
+
+typedef struct {
+    uint32_t blocks;
+    uint32_t magic;
+} Trailer;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t id;
+    uint32_t table_size;
+} DictHeader;
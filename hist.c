@@ -0,0 +1,65 @@
+// clang-format off
+#include "hist.h"		// Histogram header file
+#include "defines.h"	// Defines header file
+
+#include <stdint.h>		// Declares more integer types
+#include <string.h>		// Used for memcpy and memset
+// clang-format on
+
+// Counting one byte at a time makes every increment wait on the one before
+// it whenever the same symbol repeats, since both load and store the same
+// bucket. Instead, 8 bytes are loaded at once and spread over 4 separate
+// sub-histograms, so runs of a symbol touch 4 different buckets, and the
+// sub-histograms are merged at the end.
+
+#define HIST_BANKS 4         // Sub-histograms counted side by side
+#define HIST_CHUNK (1 << 30) // Most bytes counted before a merge, so the
+                             // 32-bit sub-histogram counters never overflow
+
+// hist_count : Function that adds the count of every symbol in the n bytes
+// of buf to hist
+void hist_count(uint64_t hist[static ALPHABET], const uint8_t *buf,
+                uint64_t n) {
+  uint32_t banks[HIST_BANKS][ALPHABET];
+  while (n > 0) {
+    uint64_t len = n < HIST_CHUNK ? n : HIST_CHUNK;
+    memset(banks, 0, sizeof(banks));
+    uint64_t i = 0;
+    for (; i + 8 <= len; i += 8) { // Fast path: 8 bytes per load
+      uint64_t w;
+      memcpy(&w, buf + i, 8);
+      banks[0][w & 0xFF] += 1;
+      banks[1][(w >> 8) & 0xFF] += 1;
+      banks[2][(w >> 16) & 0xFF] += 1;
+      banks[3][(w >> 24) & 0xFF] += 1;
+      banks[0][(w >> 32) & 0xFF] += 1;
+      banks[1][(w >> 40) & 0xFF] += 1;
+      banks[2][(w >> 48) & 0xFF] += 1;
+      banks[3][w >> 56] += 1;
+    }
+    for (; i < len; i += 1) { // Leftover bytes
+      banks[0][buf[i]] += 1;
+    }
+    for (int s = 0; s < ALPHABET; s += 1) { // Merge our sub-histograms
+      hist[s] += (uint64_t)banks[0][s] + banks[1][s] + banks[2][s] +
+                 banks[3][s];
+    }
+    buf += len;
+    n -= len;
+  }
+  return;
+}
+
+// hist_pairs : Function that adds the count of every symbol in the n (less
+// than 2^32) bytes of buf to hist, under the symbol before it; the first
+// symbol counts as following 0. Pairs are spread over rows already, so they
+// are counted one at a time.
+void hist_pairs(uint32_t hist[static ALPHABET][ALPHABET], const uint8_t *buf,
+                uint64_t n) {
+  uint8_t prev = 0;
+  for (uint64_t i = 0; i < n; i += 1) {
+    hist[prev][buf[i]] += 1;
+    prev = buf[i];
+  }
+  return;
+}
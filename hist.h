@@ -0,0 +1,10 @@
+#pragma once
+
+#include "defines.h"
+#include <stdint.h>
+
+void hist_count(uint64_t hist[static ALPHABET], const uint8_t *buf,
+                uint64_t n);
+
+void hist_pairs(uint32_t hist[static ALPHABET][ALPHABET], const uint8_t *buf,
+                uint64_t n);
@@ -0,0 +1,478 @@
+// clang-format off
+#include "huff.h"		// Huffman library header file
+#include "block.h"		// Block header file
+#include "table.h"		// Decode Table header file
+#include "adaptive.h"	// Adaptive header file
+#include "header.h"		// Headers header file
+#include "io.h"			// IO header file
+#include "defines.h"	// Defines header file
+
+#include <stdint.h>		// Declares more integer types
+#include <stdlib.h>		// Used for macros and functions used in our program
+#include <string.h>		// Used for memcpy and memmove
+#include <sys/stat.h>	// Used for permission bits
+// clang-format on
+
+// libhuffman codes buffers in memory, with no file descriptors and no global
+// state, so any number of contexts may be used on separate threads at once
+// (a single context must not be shared between threads). Compressed data is
+// in the framed format of block.c, so ./decode reads whatever the library
+// writes, and huff_decompress reads anything ./encode writes.
+//
+// The streaming calls take input a piece at a time and hand out whatever
+// output is ready; output that does not fit in dst waits in the context
+// until a later call, see huff_pending.
+
+// Buffer Struct, bytes collected by a context
+typedef struct {
+  uint8_t *data; // Bytes collected
+  uint64_t size; // Number of bytes in data
+  uint64_t pos;  // Number of bytes of data already handed out
+  uint64_t cap;  // Bytes allocated for data
+  bool fixed;    // Set if data belongs to the caller and can't grow
+} Buffer;
+
+// HuffCtx Struct, the state of one compression or decompression
+struct HuffCtx {
+  uint32_t block_size; // Uncompressed bytes per block
+  uint32_t limit;      // Longest code allowed
+  Buffer out;          // Output not yet handed out
+  Buffer in;           // Input waiting for a whole block
+  BlockIndex index;    // Blocks compressed so far
+  bool started;        // Set once the Header is produced or consumed
+  bool ended;          // Set once the BLOCK_END block is produced or consumed
+  bool stored;         // Set if the stream being decompressed is stored
+  uint64_t left;       // Raw bytes of a stored stream still to come
+  bool failed;         // Set once anything went wrong
+};
+
+// huff_create : Constructor for a context that compresses blocks of
+// block_size bytes with codes of at most limit bits; 0 picks the default for
+// either. Returns NULL if either is out of range or if error.
+HuffCtx *huff_create(uint32_t block_size, uint32_t limit) {
+  block_size = block_size ? block_size : BLOCK_SIZE;
+  limit = limit ? limit : MAX_LIMIT;
+  if (block_size > MAX_BLOCK || limit < 8 || limit > MAX_LIMIT) {
+    return NULL;
+  }
+  HuffCtx *ctx = (HuffCtx *)calloc(1, sizeof(HuffCtx));
+  if (ctx != NULL) {
+    ctx->block_size = block_size;
+    ctx->limit = limit;
+    huff_reset(ctx);
+  }
+  return ctx;
+}
+
+// huff_delete : Function that deletes a context
+void huff_delete(HuffCtx **ctx) {
+  if (*ctx != NULL) {
+    free((*ctx)->out.data);
+    free((*ctx)->in.data);
+    free((*ctx)->index.entries);
+    free(*ctx);
+    *ctx = NULL;
+  }
+  return;
+}
+
+// huff_reset : Function that abandons whatever a context was doing so it
+// can start a new stream. Its buffers are kept for reuse.
+void huff_reset(HuffCtx *ctx) {
+  ctx->out.size = 0;
+  ctx->out.pos = 0;
+  ctx->in.size = 0;
+  ctx->in.pos = 0;
+  ctx->index.blocks = 0;
+  ctx->index.raw_offset = 0;
+  ctx->index.comp_offset = sizeof(Header);
+  ctx->started = 0;
+  ctx->ended = 0;
+  ctx->stored = 0;
+  ctx->left = 0;
+  ctx->failed = 0;
+  return;
+}
+
+// huff_bound : Function that returns the most bytes huff_compress can write
+// for srclen bytes of input
+uint64_t huff_bound(HuffCtx *ctx, uint64_t srclen) {
+  uint64_t blocks = (srclen + ctx->block_size - 1) / ctx->block_size;
+  return sizeof(Header) +
+         blocks * (sizeof(BlockHeader) + MAX_LENS_SIZE + 5 * STREAMS +
+                   sizeof(IndexEntry)) +
+         (srclen * ctx->limit + 7) / 8 + sizeof(BlockHeader) +
+         sizeof(Trailer);
+}
+
+// grow : Helper function that adds n bytes to the end of a Buffer and
+// returns them, or NULL if a fixed Buffer is full or if error
+static uint8_t *grow(Buffer *b, uint64_t n) {
+  if (b->size + n > b->cap) {
+    uint64_t cap = b->cap ? 2 * b->cap : BLOCK;
+    while (cap < b->size + n) {
+      cap *= 2;
+    }
+    uint8_t *data = b->fixed ? NULL : (uint8_t *)realloc(b->data, cap);
+    if (data == NULL) {
+      return NULL;
+    }
+    b->data = data;
+    b->cap = cap;
+  }
+  b->size += n;
+  return b->data + b->size - n;
+}
+
+// take : Helper function that hands out up to dstcap bytes of a Buffer to
+// dst. Returns the number of bytes handed out.
+static uint64_t take(Buffer *b, uint8_t *dst, uint64_t dstcap) {
+  uint64_t n = b->size - b->pos < dstcap ? b->size - b->pos : dstcap;
+  if (n > 0) {
+    memcpy(dst, b->data + b->pos, n);
+  }
+  b->pos += n;
+  if (b->pos == b->size) { // Everything is out; start over at the front
+    b->pos = 0;
+    b->size = 0;
+  }
+  return n;
+}
+
+// put_header : Helper function that adds the Header of a framed stream of
+// file_size bytes to our output
+static void put_header(HuffCtx *ctx, uint64_t file_size) {
+  Header h;
+  h.magic = MAGIC_BLOCKS;
+  h.permissions = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+  h.tree_size = 0;
+  h.file_size = file_size;
+  uint8_t *out = grow(&ctx->out, sizeof(Header));
+  if (out == NULL) {
+    ctx->failed = 1;
+    return;
+  }
+  memcpy(out, &h, sizeof(Header));
+  ctx->started = 1;
+  return;
+}
+
+// put_block : Helper function that compresses n (> 0) bytes of src into a
+// block and adds it to our output and our index
+static void put_block(HuffCtx *ctx, uint8_t *src, uint32_t n) {
+  uint32_t size = 0;
+  uint8_t *block = block_encode(src, n, ctx->limit, STREAMS, BLOCK_HUFFMAN,
+                                &size);
+  uint8_t *out = block == NULL ? NULL : grow(&ctx->out, size);
+  if (out == NULL || !index_add(&ctx->index, n, size)) {
+    ctx->failed = 1;
+  } else {
+    memcpy(out, block, size);
+  }
+  free(block);
+  return;
+}
+
+// put_end : Helper function that compresses whatever input is left and adds
+// the BLOCK_END block holding our index to our output
+static void put_end(HuffCtx *ctx) {
+  if (ctx->in.size > 0) {
+    put_block(ctx, ctx->in.data, ctx->in.size);
+    ctx->in.size = 0;
+  }
+  uint8_t *out = grow(&ctx->out, index_size(&ctx->index));
+  if (out == NULL) {
+    ctx->failed = 1;
+    return;
+  }
+  index_pack(&ctx->index, out);
+  ctx->ended = 1;
+  return;
+}
+
+// huff_compress : Function that compresses srclen bytes of src into dst,
+// which holds dstcap bytes; huff_bound(srclen) bytes are always enough.
+// Abandons any stream in progress. Returns the size of the output, or
+// HUFF_ERROR if dst is too small or if error.
+uint64_t huff_compress(HuffCtx *ctx, uint8_t *src, uint64_t srclen,
+                       uint8_t *dst, uint64_t dstcap) {
+  Buffer out = ctx->out; // Write straight into dst instead of our buffer
+  ctx->out = (Buffer){dst, 0, 0, dstcap, 1};
+  huff_reset(ctx);
+  put_header(ctx, srclen);
+  for (uint64_t i = 0; i < srclen && !ctx->failed; i += ctx->block_size) {
+    put_block(ctx, src + i,
+              srclen - i < ctx->block_size ? srclen - i : ctx->block_size);
+  }
+  if (!ctx->failed) {
+    put_end(ctx);
+  }
+  uint64_t size = ctx->failed ? HUFF_ERROR : ctx->out.size;
+  ctx->out = out;
+  huff_reset(ctx);
+  return size;
+}
+
+// huff_decompress : Function that decompresses srclen bytes of src, in any
+// format ./encode writes, into dst, which holds dstcap bytes. Abandons any
+// stream in progress. Returns the size of the output, or HUFF_ERROR if src
+// is malformed, if dst is too small or if error.
+uint64_t huff_decompress(HuffCtx *ctx, uint8_t *src, uint64_t srclen,
+                         uint8_t *dst, uint64_t dstcap) {
+  huff_reset(ctx);
+  BitReader r; // Reads straight out of src
+  br_init(&r, -1, src, srclen);
+  Header h;
+  if (br_read_bytes(&r, (uint8_t *)&h, sizeof(h)) != sizeof(h)) {
+    return HUFF_ERROR;
+  }
+  if (h.magic == MAGIC_BLOCKS) { // Decode block after block
+    uint64_t size = 0;
+    BlockHeader bh;
+    while (br_read_bytes(&r, (uint8_t *)&bh, sizeof(bh)) == sizeof(bh)) {
+      if (bh.type == BLOCK_END) {
+        return h.file_size == UNKNOWN_SIZE || h.file_size == size
+                   ? size
+                   : HUFF_ERROR;
+      }
+      uint8_t *payload = br_view(&r, bh.comp_size);
+      if (!block_check(&bh) || payload == NULL ||
+          bh.raw_size > dstcap - size ||
+          !block_decode(&bh, payload, dst + size)) {
+        return HUFF_ERROR;
+      }
+      size += bh.raw_size;
+    }
+    return HUFF_ERROR; // Ran out of input before the BLOCK_END block
+  }
+  if (h.magic == MAGIC_STORED) { // The raw bytes follow the Header
+    if (h.file_size > dstcap || srclen - sizeof(Header) < h.file_size) {
+      return HUFF_ERROR;
+    }
+    memcpy(dst, src + sizeof(Header), h.file_size);
+    return h.file_size;
+  }
+  if (h.magic == MAGIC_ADAPT) { // Learn the codes symbol by symbol
+    Adaptive *a = ad_create();
+    if (a == NULL) {
+      return HUFF_ERROR;
+    }
+    uint64_t size = 0;
+    uint16_t symbol = 0;
+    while (ad_decode(a, &r, &symbol) > 0 && symbol != AD_END) {
+      if (symbol == AD_FLUSH) { // Nothing to hand out
+        continue;
+      }
+      if (size == dstcap) { // Out of room
+        break;
+      }
+      dst[size] = symbol;
+      size += 1;
+    }
+    ad_delete(&a);
+    return symbol == AD_END &&
+                   (h.file_size == UNKNOWN_SIZE || h.file_size == size)
+               ? size
+               : HUFF_ERROR;
+  }
+  if (h.file_size > dstcap) {
+    return HUFF_ERROR;
+  }
+  DecodeTable *t = dt_read(&h, &r, NULL); // One table for the whole file
+  if (t == NULL) {
+    return HUFF_ERROR;
+  }
+  uint64_t size = 0;
+  while (size < h.file_size) {
+    uint32_t want = h.file_size - size < MAX_BLOCK ? h.file_size - size
+                                                   : MAX_BLOCK;
+    uint32_t got = dt_decode_bytes(t, &r, dst + size, want);
+    size += got;
+    if (got < want) { // Ran out of codes
+      break;
+    }
+  }
+  dt_delete(&t);
+  return size == h.file_size ? size : HUFF_ERROR;
+}
+
+// huff_decompress_range : Function that decompresses length bytes, starting
+// offset bytes into the uncompressed data, of the framed or stored file held
+// in the srclen bytes of src into dst, which holds dstcap bytes. Only the
+// blocks holding the range are decoded, using the block index at the end of
+// src. The range is cut short at the end of the data. Abandons any stream in
+// progress. Returns the size of the output, or HUFF_ERROR if src is neither
+// a framed nor a stored file or is malformed, if dst is too small or if
+// error.
+uint64_t huff_decompress_range(HuffCtx *ctx, uint8_t *src, uint64_t srclen,
+                               uint64_t offset, uint64_t length, uint8_t *dst,
+                               uint64_t dstcap) {
+  huff_reset(ctx);
+  Header h;
+  if (srclen >= sizeof(Header)) {
+    memcpy(&h, src, sizeof(Header));
+  }
+  if (srclen >= sizeof(Header) && h.magic == MAGIC_STORED) { // Just copy it
+    if (srclen - sizeof(Header) < h.file_size) {
+      return HUFF_ERROR;
+    }
+    offset = offset < h.file_size ? offset : h.file_size;
+    length = length < h.file_size - offset ? length : h.file_size - offset;
+    if (length > dstcap) {
+      return HUFF_ERROR;
+    }
+    memcpy(dst, src + sizeof(Header) + offset, length);
+    return length;
+  }
+  if (!index_read(src, srclen, &ctx->index)) {
+    return HUFF_ERROR;
+  }
+  uint64_t size = ctx->index.raw_offset; // Uncompressed size of src
+  offset = offset < size ? offset : size;
+  length = length < size - offset ? length : size - offset;
+  bool ok = length <= dstcap &&
+            decode_range(src, &ctx->index, offset, length, -1, dst);
+  huff_reset(ctx); // Our index is only good for this call
+  return ok ? length : HUFF_ERROR;
+}
+
+// huff_stream_compress : Function that adds srclen bytes of src to the
+// stream being compressed and hands out up to dstcap bytes of compressed
+// output to dst. Output is made a whole block at a time. Returns the number
+// of bytes handed out, or HUFF_ERROR if the stream has ended or if error.
+uint64_t huff_stream_compress(HuffCtx *ctx, uint8_t *src, uint64_t srclen,
+                              uint8_t *dst, uint64_t dstcap) {
+  if (!ctx->started && !ctx->failed) {
+    put_header(ctx, UNKNOWN_SIZE); // Streams don't know their size up front
+  }
+  while (srclen > 0 && !ctx->failed && !ctx->ended) {
+    if (ctx->in.size == 0 && srclen >= ctx->block_size) { // Whole block in
+      put_block(ctx, src, ctx->block_size);               // place
+      src += ctx->block_size;
+      srclen -= ctx->block_size;
+      continue;
+    }
+    uint64_t n = ctx->block_size - ctx->in.size < srclen
+                     ? ctx->block_size - ctx->in.size
+                     : srclen;
+    uint8_t *in = grow(&ctx->in, n); // Hold on to a partial block
+    if (in == NULL) {
+      ctx->failed = 1;
+      break;
+    }
+    memcpy(in, src, n);
+    src += n;
+    srclen -= n;
+    if (ctx->in.size == ctx->block_size) {
+      put_block(ctx, ctx->in.data, ctx->in.size);
+      ctx->in.size = 0;
+    }
+  }
+  if (ctx->failed || ctx->ended) {
+    return HUFF_ERROR;
+  }
+  return take(&ctx->out, dst, dstcap);
+}
+
+// huff_stream_end : Function that ends the stream being compressed and
+// hands out up to dstcap bytes of the output left to dst. Call it again
+// while huff_pending is not 0. Returns the number of bytes handed out, or
+// HUFF_ERROR if error.
+uint64_t huff_stream_end(HuffCtx *ctx, uint8_t *dst, uint64_t dstcap) {
+  if (!ctx->started && !ctx->failed) {
+    put_header(ctx, UNKNOWN_SIZE);
+  }
+  if (!ctx->ended && !ctx->failed) {
+    put_end(ctx);
+  }
+  if (ctx->failed) {
+    return HUFF_ERROR;
+  }
+  return take(&ctx->out, dst, dstcap);
+}
+
+// huff_stream_decompress : Function that adds srclen bytes of src to the
+// framed or stored stream being decompressed and hands out up to dstcap
+// bytes of decompressed output to dst. Output is made a whole block at a time
+// (stored bytes as they arrive); see huff_done to tell when the stream is
+// over. Returns the number of bytes handed out, or HUFF_ERROR if the stream
+// is malformed or if error.
+uint64_t huff_stream_decompress(HuffCtx *ctx, uint8_t *src, uint64_t srclen,
+                                uint8_t *dst, uint64_t dstcap) {
+  uint8_t *in = srclen > 0 && !ctx->ended ? grow(&ctx->in, srclen) : NULL;
+  if (in != NULL) {
+    memcpy(in, src, srclen);
+  } else if (srclen > 0 && !ctx->ended) {
+    ctx->failed = 1;
+  }
+  uint64_t used = 0; // Bytes of input decoded so far
+  while (!ctx->failed && !ctx->ended) {
+    uint8_t *next = ctx->in.data + used;
+    uint64_t left = ctx->in.size - used;
+    if (!ctx->started) { // Our Header comes first
+      Header h;
+      if (left < sizeof(Header)) {
+        break;
+      }
+      memcpy(&h, next, sizeof(Header));
+      ctx->failed = h.magic != MAGIC_BLOCKS &&
+                    h.magic != MAGIC_STORED; // Only these files stream
+      ctx->stored = h.magic == MAGIC_STORED;
+      ctx->left = ctx->stored ? h.file_size : 0;
+      ctx->ended = ctx->stored && ctx->left == 0;
+      ctx->started = 1;
+      used += sizeof(Header);
+      continue;
+    }
+    if (ctx->stored) { // Hand the raw bytes on as they arrive
+      uint64_t n = left < ctx->left ? left : ctx->left;
+      uint8_t *out = n > 0 ? grow(&ctx->out, n) : NULL;
+      if (out == NULL) {
+        ctx->failed = n > 0;
+        break;
+      }
+      memcpy(out, next, n);
+      used += n;
+      ctx->left -= n;
+      ctx->ended = ctx->left == 0;
+      continue;
+    }
+    BlockHeader bh;
+    if (left < sizeof(BlockHeader)) {
+      break;
+    }
+    memcpy(&bh, next, sizeof(BlockHeader));
+    if (bh.type != BLOCK_END && !block_check(&bh)) {
+      ctx->failed = 1;
+      break;
+    }
+    if (left - sizeof(BlockHeader) < bh.comp_size) { // Wait for the rest
+      break;
+    }
+    used += sizeof(BlockHeader) + bh.comp_size;
+    if (bh.type == BLOCK_END) { // Nothing but the index is left
+      ctx->ended = 1;
+      break;
+    }
+    uint8_t *out = grow(&ctx->out, bh.raw_size);
+    ctx->failed =
+        out == NULL || !block_decode(&bh, next + sizeof(BlockHeader), out);
+  }
+  // Move the partial block we are waiting on to the front of our input
+  if (used > 0) {
+    memmove(ctx->in.data, ctx->in.data + used, ctx->in.size - used);
+    ctx->in.size -= used;
+  }
+  if (ctx->failed) {
+    return HUFF_ERROR;
+  }
+  return take(&ctx->out, dst, dstcap);
+}
+
+// huff_pending : Function that returns the number of output bytes a context
+// holds that have not been handed out yet
+uint64_t huff_pending(HuffCtx *ctx) { return ctx->out.size - ctx->out.pos; }
+
+// huff_done : Function that returns TRUE/1 once a stream being decompressed
+// has been read to its end
+bool huff_done(HuffCtx *ctx) { return ctx->ended; }
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define HUFF_ERROR UINT64_MAX // Returned by a call that failed
+
+typedef struct HuffCtx HuffCtx;
+
+HuffCtx *huff_create(uint32_t block_size, uint32_t limit);
+
+void huff_delete(HuffCtx **ctx);
+
+void huff_reset(HuffCtx *ctx);
+
+uint64_t huff_bound(HuffCtx *ctx, uint64_t srclen);
+
+uint64_t huff_compress(HuffCtx *ctx, uint8_t *src, uint64_t srclen,
+                       uint8_t *dst, uint64_t dstcap);
+
+uint64_t huff_decompress(HuffCtx *ctx, uint8_t *src, uint64_t srclen,
+                         uint8_t *dst, uint64_t dstcap);
+
+uint64_t huff_decompress_range(HuffCtx *ctx, uint8_t *src, uint64_t srclen,
+                               uint64_t offset, uint64_t length, uint8_t *dst,
+                               uint64_t dstcap);
+
+uint64_t huff_stream_compress(HuffCtx *ctx, uint8_t *src, uint64_t srclen,
+                              uint8_t *dst, uint64_t dstcap);
+
+uint64_t huff_stream_end(HuffCtx *ctx, uint8_t *dst, uint64_t dstcap);
+
+uint64_t huff_stream_decompress(HuffCtx *ctx, uint8_t *src, uint64_t srclen,
+                                uint8_t *dst, uint64_t dstcap);
+
+uint64_t huff_pending(HuffCtx *ctx);
+
+bool huff_done(HuffCtx *ctx);
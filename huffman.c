@@ -1,131 +1,493 @@
 // clang-format off
 #include "huffman.h"	// Huffman header file
 #include "io.h"		    // IO header file
-#include "node.h"		// Node header file
-#include "pq.h"		    // PQ header file
 #include "code.h"		// Code header file
-#include "stack.h"	    // Code header file
+#include "defines.h"	// Defines header file
 
+#include <math.h>	    // Used for log2
 #include <stdint.h>	    // Declares more integer types
 #include <stdio.h>	    // Used for input and output for our program
 #include <stdlib.h>	    // Used for macros and functions used in our program
 // clang-format on
 
-// build_tree : Function that builds a Huffman tree given a histogram
-Node *build_tree(uint64_t hist[static ALPHABET]) {
-  // Creating our PQ
-  PriorityQueue *q = pq_create(ALPHABET);
-  // Iterating our Histogram and adding symbols with frequencies > 0 to our PQ
-  // as Nodes
-  for (uint64_t i = 0; i < ALPHABET; i += 1) {
+// Leaf Struct, a symbol and its frequency, for sorting symbols once up front
+typedef struct {
+  uint64_t frequency;
+  uint16_t symbol;
+} Leaf;
+
+// leaf_cmp : Helper function that orders Leaves by frequency, then symbol
+static int leaf_cmp(const void *a, const void *b) {
+  const Leaf *x = (const Leaf *)a;
+  const Leaf *y = (const Leaf *)b;
+  if (x->frequency != y->frequency) {
+    return x->frequency < y->frequency ? -1 : 1;
+  }
+  return x->symbol - y->symbol;
+}
+
+// A Huffman tree is flat: all of its Nodes live in one array inside the Tree
+// and refer to their children by index, so building one never calls malloc
+// and a Tree is freed along with whatever holds it. Children always come
+// before their parents, which lets us walk the tree from the root down by
+// simply going through the array backwards.
+
+// add_node : Helper function that appends a Node to a Tree and returns its
+// index
+static uint16_t add_node(Tree *t, uint16_t left, uint16_t right,
+                         uint8_t symbol, uint64_t frequency) {
+  TreeNode *n = &t->nodes[t->size];
+  n->left = left;
+  n->right = right;
+  n->symbol = symbol;
+  n->frequency = frequency;
+  t->size += 1;
+  return t->size - 1;
+}
+
+// take_min : Helper function for build_tree that removes and returns the
+// lower frequency front Node of our two queues: the leaves, which are sorted,
+// and the joined parents, which are made in order of frequency too. Ties go
+// to the leaf.
+static uint16_t take_min(Tree *t, uint16_t *next, uint16_t leaves,
+                         uint16_t *head) {
+  if (*next < leaves &&
+      (*head == t->size ||
+       t->nodes[*next].frequency <= t->nodes[*head].frequency)) {
+    return (*next)++;
+  }
+  return (*head)++;
+}
+
+// build_tree : Function that builds a Huffman tree in t given a histogram.
+// The symbols are sorted by frequency once and stored as the first Nodes of
+// t, after which the two smallest Nodes are always at the front of either
+// the leaves or the parents joined so far, so the tree is built in O(n) with
+// two queues instead of a Priority Queue. Returns FALSE/0 if the histogram
+// is empty.
+bool build_tree(uint64_t hist[static ALPHABET], Tree *t) {
+  // Sorting the symbols with frequencies > 0 by frequency
+  Leaf sorted[ALPHABET];
+  uint16_t leaves = 0;
+  for (uint32_t i = 0; i < ALPHABET; i += 1) {
     if (hist[i] > 0) {
-      Node *cur = node_create(i, hist[i]);
-      enqueue(q, cur);
-    }
-  }
-  // While there are two or more nodes in our PQ
-  while (pq_size(q) >= 2) {
-    Node *left;
-    Node *right;
-    dequeue(q, &left);                     // First dequeue is our left child
-    dequeue(q, &right);                    // Second dequeue is our right child
-    Node *joined = node_join(left, right); // Join the two
-    enqueue(q, joined);                    // Enqueue the joined parent
-  }
-  // After our loop there is one node left in our PQ
-  Node *ret;
-  dequeue(q, &ret); // This will be the root of our tree
-  pq_delete(&q);    // Delete our PQ
-  return ret;       // Return the root of our tree
+      sorted[leaves].frequency = hist[i];
+      sorted[leaves].symbol = i;
+      leaves += 1;
+    }
+  }
+  t->size = 0;
+  t->root = NIL;
+  if (leaves == 0) {
+    return 0;
+  }
+  qsort(sorted, leaves, sizeof(Leaf), leaf_cmp);
+  for (uint16_t i = 0; i < leaves; i += 1) {
+    add_node(t, NIL, NIL, sorted[i].symbol, sorted[i].frequency);
+  }
+
+  uint16_t next = 0;      // Front of our leaves
+  uint16_t head = leaves; // Front of our joined parents
+  // While there are two or more Nodes left between both queues
+  while ((leaves - next) + (t->size - head) >= 2) {
+    uint16_t left = take_min(t, &next, leaves, &head);
+    uint16_t right = take_min(t, &next, leaves, &head);
+    add_node(t, left, right, 0,
+             t->nodes[left].frequency + t->nodes[right].frequency);
+  }
+  // The last Node made is the root of our tree
+  t->root = t->size - 1;
+  return 1;
+}
+
+// codes_walk : Helper function that adds the code of every leaf below Node n
+// to our code table, where path holds the code of n itself
+static void codes_walk(Tree *t, uint16_t n, Code *path,
+                       Code table[static ALPHABET]) {
+  uint8_t bit; // Holds the return of code_pop_bit
+  TreeNode *node = &t->nodes[n];
+  if (node->left == NIL) { // If we are at a leaf node, add the path code to
+                           // our code table
+    table[node->symbol] = *path;
+  } else {
+    code_push_bit(path, 0);                    // 0 indicates traversing left
+    codes_walk(t, node->left, path, table);    // Recursive call to left link
+    code_pop_bit(path, &bit);                  // Done visiting left link
+    code_push_bit(path, 1);                    // 1 indicates traversing right
+    codes_walk(t, node->right, path, table);   // Recursive call to right link
+    code_pop_bit(path, &bit);                  // Done visiting right link
+  }
+  return;
 }
 
-static Code c;       // Temp code to hold current path
-static uint8_t temp; // Temp bit to hold the return of code_pop_bit
-static uint8_t initialize_c =
-    1; // Will act as a boolean variable to get our temp code initialized
-
-// build_codes : Function that populates a code table
-void build_codes(Node *root, Code table[static ALPHABET]) {
-  if (initialize_c) { // Initializes our temp code once
-    c = code_init();
-    initialize_c = 0;
-  }
-  if (root != NULL) {
-    if (root->left == NULL &&
-        root->right == NULL) { // If we are at a leaf node, add the temp code to
-                               // our code table
-      table[root->symbol] = c;
+// build_codes : Function that populates a code table from a Huffman tree
+void build_codes(Tree *t, Code table[static ALPHABET]) {
+  Code path = code_init(); // Code of the current path
+  if (t->root != NIL) {
+    codes_walk(t, t->root, &path, table);
+  }
+  return;
+}
+
+// build_lengths : Function that fills a table of code lengths from a Huffman
+// tree. Symbols that are not in the tree get a length of 0.
+void build_lengths(Tree *t, uint8_t lengths[static ALPHABET]) {
+  uint16_t depth[MAX_NODES]; // Depth of every Node
+  for (uint32_t i = 0; i < ALPHABET; i += 1) {
+    lengths[i] = 0;
+  }
+  if (t->root == NIL) {
+    return;
+  }
+  depth[t->root] = 0;
+  for (uint16_t i = t->size; i-- > 0;) { // Parents before their children
+    TreeNode *n = &t->nodes[i];
+    if (n->left == NIL) { // If we are at a leaf node
+      lengths[n->symbol] = depth[i];
     } else {
-      code_push_bit(&c, 0);            // 0 indicates traversing left link
-      build_codes(root->left, table);  // Recursive call to left link
-      code_pop_bit(&c, &temp);         // Done visiting left link, pop the 0 bit
-      code_push_bit(&c, 1);            // 1 indicates traversing right link
-      build_codes(root->right, table); // Recursive call to right link
-      code_pop_bit(&c, &temp); // Done visiting right link, pop the 1 bit
+      depth[n->left] = depth[i] + 1;
+      depth[n->right] = depth[i] + 1;
     }
   }
   return;
 }
 
-// dump_tree : Function that writes the bytes of the symbols of the Nodes from
-// our Huffman tree to outfile
-void dump_tree(int outfile, Node *root) {
-  uint8_t l = 'L'; // Will be used to indicate that the bytes after are the
-                   // symbol of a leaf node
-  uint8_t i = 'I'; // WIll be used to indicate that we are at an interior node
-  if (root != NULL) {                // Post traversal iteration
-    dump_tree(outfile, root->left);  // Recursive call to left link
-    dump_tree(outfile, root->right); // Recursive call to right link
-    if (root->left == NULL && root->right == NULL) { // If we are at a leaf node
-      write_bytes(outfile, &l, 1);
-      write_bytes(outfile, &root->symbol, 1);
-    } else { // If we are at an interior node
-      write_bytes(outfile, &i, 1);
+// canonical_codes : Function that populates a code table with the canonical
+// codes for the passed code lengths. Codes are handed out in order of length
+// and then symbol, each one the previous code plus one, so both sides can
+// rebuild them from the lengths alone. Returns FALSE/0 if the lengths do not
+// describe a prefix code.
+bool canonical_codes(uint8_t lengths[static ALPHABET],
+                     Code table[static ALPHABET]) {
+  Code cur = code_init(); // Code handed out to the previous symbol
+  uint8_t bit = 0;        // Temp bit to hold the return of code_pop_bit
+  bool first = 1;
+  for (uint32_t len = 1; len < ALPHABET; len += 1) {
+    for (uint32_t sym = 0; sym < ALPHABET; sym += 1) {
+      if (lengths[sym] != len) {
+        continue;
+      }
+      if (!first) { // Add one to the previous code
+        uint32_t ones = 0;
+        while (code_pop_bit(&cur, &bit) && bit == 1) { // Carry through the
+          ones += 1;                                   // trailing 1 bits
+        }
+        if (bit == 1) { // No 0 bit left to carry into; we ran out of codes
+          return 0;
+        }
+        code_push_bit(&cur, 1);
+        for (uint32_t i = 0; i < ones; i += 1) {
+          code_push_bit(&cur, 0);
+        }
+      }
+      while (code_size(&cur) < len) { // Longer codes follow with 0 bits
+        code_push_bit(&cur, 0);
+      }
+      table[sym] = cur;
+      first = 0;
     }
   }
-  return;
+  return 1;
+}
+
+// build_limited_lengths : Function that fills a table of optimal code lengths
+// for the histogram where no code is longer than max_len bits, using the
+// package-merge algorithm. Symbols with a frequency of 0 get a length of 0.
+// Returns FALSE/0 if max_len bits cannot hold every symbol or if error.
+bool build_limited_lengths(uint64_t hist[static ALPHABET], uint32_t max_len,
+                           uint8_t lengths[static ALPHABET]) {
+  Leaf leaves[ALPHABET];
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < ALPHABET; i += 1) {
+    lengths[i] = 0;
+    if (hist[i] > 0) {
+      leaves[n].frequency = hist[i];
+      leaves[n].symbol = i;
+      n += 1;
+    }
+  }
+  if (n <= 1) { // A lone symbol still needs a 1 bit code
+    if (n == 1) {
+      lengths[leaves[0].symbol] = 1;
+    }
+    return 1;
+  }
+  if (max_len == 0 || max_len >= ALPHABET ||
+      (max_len < 32 && (1U << max_len) < n)) {
+    return 0; // Not enough codes of max_len bits for every symbol
+  }
+  qsort(leaves, n, sizeof(Leaf), leaf_cmp);
+
+  // One list per code length, each a merge of the leaves with the packages
+  // (pairs) of the list one level deeper. Only the first 2n - 2 items of any
+  // list can ever be selected.
+  uint32_t cap = 2 * n - 2;
+  uint64_t *weight = (uint64_t *)malloc(max_len * cap * sizeof(uint64_t));
+  int16_t *item = (int16_t *)malloc(max_len * cap * sizeof(int16_t));
+  uint32_t size[ALPHABET]; // Number of items in each list
+  if (weight == NULL || item == NULL) {
+    free(weight);
+    free(item);
+    return 0;
+  }
+  for (uint32_t d = max_len; d > 0; d -= 1) { // Deepest list first
+    uint64_t *w = weight + (d - 1) * cap;
+    int16_t *it = item + (d - 1) * cap; // Leaf index, or -1 for a package
+    uint64_t *prev = weight + d * cap;
+    uint32_t packages = d == max_len ? 0 : size[d] / 2;
+    uint32_t l = 0; // Next leaf to merge
+    uint32_t p = 0; // Next package to merge
+    size[d - 1] = 0;
+    while (size[d - 1] < cap && (l < n || p < packages)) {
+      uint32_t k = size[d - 1];
+      uint64_t pw = p < packages ? prev[2 * p] + prev[2 * p + 1] : 0;
+      if (l < n && (p == packages || leaves[l].frequency <= pw)) {
+        w[k] = leaves[l].frequency; // Leaves win ties
+        it[k] = l;
+        l += 1;
+      } else {
+        w[k] = pw;
+        it[k] = -1;
+        p += 1;
+      }
+      size[d - 1] += 1;
+    }
+  }
+
+  // Select the first 2n - 2 items of the top list; every package selected
+  // at one level selects two more items from the next level down. Each time
+  // a leaf is selected its code gets one bit longer.
+  uint32_t m = cap;
+  for (uint32_t d = 1; d <= max_len && m > 0; d += 1) {
+    int16_t *it = item + (d - 1) * cap;
+    uint32_t packages = 0;
+    for (uint32_t k = 0; k < m; k += 1) {
+      if (it[k] < 0) {
+        packages += 1;
+      } else {
+        lengths[leaves[it[k]].symbol] += 1;
+      }
+    }
+    m = 2 * packages;
+  }
+  free(weight);
+  free(item);
+  return 1;
+}
+
+// pack_lengths : Function that packs a table of code lengths into buf. A
+// non-zero byte is a code length; a 0 byte is followed by a count byte and
+// stands for count + 1 zero lengths. Returns the number of bytes in buf.
+uint16_t pack_lengths(uint8_t lengths[static ALPHABET],
+                      uint8_t buf[static MAX_LENS_SIZE]) {
+  uint16_t n = 0;
+  for (uint32_t i = 0; i < ALPHABET;) {
+    if (lengths[i] != 0) { // Code lengths are stored as they are
+      buf[n] = lengths[i];
+      n += 1;
+      i += 1;
+      continue;
+    }
+    uint32_t run = 0; // Zero lengths are stored as a run
+    while (i + run < ALPHABET && lengths[i + run] == 0) {
+      run += 1;
+    }
+    buf[n] = 0;
+    buf[n + 1] = run - 1;
+    n += 2;
+    i += run;
+  }
+  return n;
+}
+
+// unpack_lengths : Function that unpacks nbytes bytes made by pack_lengths
+// into a table of code lengths. Returns FALSE/0 if buf is malformed.
+bool unpack_lengths(uint16_t nbytes, uint8_t buf[static nbytes],
+                    uint8_t lengths[static ALPHABET]) {
+  uint32_t sym = 0;
+  for (uint16_t i = 0; i < nbytes; i += 1) {
+    if (buf[i] != 0) { // A single code length
+      if (sym >= ALPHABET) {
+        return 0;
+      }
+      lengths[sym] = buf[i];
+      sym += 1;
+    } else { // A run of zero lengths
+      if (i + 1 >= nbytes || sym + buf[i + 1] + 1 > ALPHABET) {
+        return 0;
+      }
+      for (uint32_t j = 0; j <= buf[i + 1]; j += 1) {
+        lengths[sym] = 0;
+        sym += 1;
+      }
+      i += 1;
+    }
+  }
+  return sym == ALPHABET; // Every symbol must have a length
 }
 
-// rebuild_tree : Function that will rebuild our Huffman tree from our dumped
-// tree
-Node *rebuild_tree(uint16_t nbytes, uint8_t tree[static nbytes]) {
-  // Create our stack
-  Stack *s = stack_create(nbytes);
+// dump_tree : Function that writes the symbols of the Nodes of our Huffman
+// tree to buf in post-order: 'L' and the symbol for a leaf, 'I' for an
+// interior node. Returns the number of bytes written to buf.
+uint16_t dump_tree(Tree *t, uint8_t buf[static MAX_TREE_SIZE]) {
+  uint16_t stack[MAX_NODES]; // Nodes left to visit
+  uint16_t top = 0;          // Number of Nodes on our stack
+  uint16_t nbytes = 0;
+  uint16_t last = NIL; // Last Node dumped
+  if (t->root != NIL) {
+    stack[top++] = t->root;
+  }
+  while (top > 0) { // Post order iteration
+    TreeNode *n = &t->nodes[stack[top - 1]];
+    if (n->left != NIL && last != n->right) { // Visit our children first
+      stack[top++] = n->right;
+      stack[top++] = n->left;
+      continue;
+    }
+    if (n->left == NIL) { // If we are at a leaf node
+      buf[nbytes++] = 'L';
+      buf[nbytes++] = n->symbol;
+    } else { // If we are at an interior node
+      buf[nbytes++] = 'I';
+    }
+    last = stack[--top];
+  }
+  return nbytes;
+}
 
-  // Node place holders
-  Node *cur;
-  Node *left;
-  Node *right;
+// rebuild_tree : Function that will rebuild our Huffman tree in t from our
+// dumped tree. Returns FALSE/0 if the dump does not describe exactly one
+// tree.
+bool rebuild_tree(uint16_t nbytes, uint8_t tree[static nbytes], Tree *t) {
+  uint16_t stack[MAX_NODES]; // Subtrees waiting for a parent
+  uint16_t top = 0;          // Number of subtrees on our stack
+  t->size = 0;
+  t->root = NIL;
 
   // Iterate through our dumped tree
   for (uint16_t i = 0; i < nbytes; i += 1) {
-    if (tree[i] == 'L') { // Indicates that the next element will be a symbol
-                          // for a leaf node
-      i += 1;             // Increment counter to go to next element
-      cur = node_create(tree[i], 0); // Create a node with that symbol
-      stack_push(s, cur);            // Push the node onto our stack
-    } else if (tree[i] ==
-               'I') { // Indicates that we have encountered an interior node.
-      stack_pop(s, &right); // First pop off the stack is our right child
-      stack_pop(s, &left);  // Second pop off the stack is our left child
-      cur = node_join(left, right); // Join the two children
-      stack_push(s, cur);           // Push the parent onto the stack
-    }
-  }
-  // Last node on our stack is the root of our huffman tree
-  stack_pop(s, &cur);
-  stack_delete(&s);
-  return cur;
+    if (t->size == MAX_NODES) { // More Nodes than any tree can hold
+      return 0;
+    }
+    if (tree[i] == 'L' && i + 1 < nbytes) { // Indicates that the next element
+                                            // will be a symbol for a leaf node
+      i += 1; // Increment counter to go to next element
+      stack[top++] = add_node(t, NIL, NIL, tree[i], 0);
+    } else if (tree[i] == 'I' && top >= 2) { // Indicates that we have
+                                             // encountered an interior node
+      uint16_t right = stack[--top]; // First pop is our right child
+      uint16_t left = stack[--top];  // Second pop is our left child
+      stack[top++] = add_node(t, left, right, 0, 0);
+    } else {
+      return 0;
+    }
+  }
+  if (top != 1) { // Last subtree on our stack is the root of our tree
+    return 0;
+  }
+  t->root = stack[0];
+  return 1;
 }
 
-// delete_tree : Function that acts as a destructor for a Huffman tree
-void delete_tree(Node **root) {
-  if (*root) {
-    // Post-order traversal to free all nodes
-    delete_tree(&(*root)->left);
-    delete_tree(&(*root)->right);
-    node_delete(root);
+// cluster_cost : Helper function that fills cost with an estimate of the
+// bits every symbol takes when coded with the codes of a cluster histogram.
+// Symbols the cluster has never seen get a small share so no cost is
+// infinite.
+static void cluster_cost(uint64_t hist[static ALPHABET],
+                         float cost[static ALPHABET]) {
+  uint64_t total = 0;
+  for (int s = 0; s < ALPHABET; s += 1) {
+    total += hist[s];
+  }
+  for (int s = 0; s < ALPHABET; s += 1) {
+    cost[s] = -log2f((hist[s] + 0.5f) / (total + 0.5f * ALPHABET));
   }
-  (*root) = NULL; // Setting our pointer to NULL
   return;
 }
+
+// cluster_contexts : Function that groups the contexts of an order-1
+// histogram, hist[context][symbol], into at most tables clusters of contexts
+// whose symbols follow similar distributions, so every cluster can share one
+// code table. A few rounds of k-means move each context to the cluster that
+// codes it in the fewest bits, starting from the busiest contexts. Fills map
+// with the cluster of every context and clusters with the histogram of every
+// cluster. Returns the number of clusters, at least 1.
+uint32_t cluster_contexts(uint32_t hist[static ALPHABET][ALPHABET],
+                          uint32_t tables, uint8_t map[static ALPHABET],
+                          uint64_t clusters[][ALPHABET]) {
+  uint64_t totals[ALPHABET];
+  Leaf busiest[ALPHABET]; // Contexts by how many symbols follow them
+  uint32_t active = 0;    // Contexts that are followed by anything
+  for (int c = 0; c < ALPHABET; c += 1) {
+    totals[c] = 0;
+    for (int s = 0; s < ALPHABET; s += 1) {
+      totals[c] += hist[c][s];
+    }
+    busiest[c].frequency = UINT64_MAX - totals[c]; // Busiest first
+    busiest[c].symbol = c;
+    active += totals[c] > 0;
+    map[c] = UINT8_MAX; // In no cluster yet
+  }
+  qsort(busiest, ALPHABET, sizeof(Leaf), leaf_cmp);
+  uint32_t k = active < tables ? active : tables;
+  k = k > 0 ? k : 1;
+  for (uint32_t i = 0; i < k; i += 1) { // Seed a cluster with each
+    map[busiest[i].symbol] = i;
+  }
+
+  float cost[CTX_TABLES][ALPHABET];
+  for (uint32_t round = 0; round <= CTX_ROUNDS; round += 1) {
+    // Sum up the contexts of every cluster, dropping empty clusters
+    uint32_t renumber[CTX_TABLES];
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < k; i += 1) {
+      for (int s = 0; s < ALPHABET; s += 1) {
+        clusters[i][s] = 0;
+      }
+    }
+    for (int c = 0; c < ALPHABET; c += 1) {
+      for (int s = 0; map[c] < k && s < ALPHABET; s += 1) {
+        clusters[map[c]][s] += hist[c][s];
+      }
+    }
+    for (uint32_t i = 0; i < k; i += 1) {
+      uint64_t total = 0;
+      for (int s = 0; s < ALPHABET; s += 1) {
+        total += clusters[i][s];
+      }
+      renumber[i] = used;
+      if (total > 0) {
+        for (int s = 0; s < ALPHABET; s += 1) {
+          clusters[used][s] = clusters[i][s];
+        }
+        used += 1;
+      }
+    }
+    for (int c = 0; c < ALPHABET; c += 1) {
+      map[c] = map[c] < k ? renumber[map[c]] : 0;
+    }
+    k = used;
+    if (round == CTX_ROUNDS) { // Our clusters match our map
+      break;
+    }
+
+    // Move every context to the cluster that codes it best
+    for (uint32_t i = 0; i < k; i += 1) {
+      cluster_cost(clusters[i], cost[i]);
+    }
+    for (int c = 0; c < ALPHABET; c += 1) {
+      float best = INFINITY;
+      for (uint32_t i = 0; totals[c] > 0 && i < k; i += 1) {
+        float bits = 0;
+        for (int s = 0; s < ALPHABET; s += 1) {
+          bits += hist[c][s] * cost[i][s];
+        }
+        if (bits < best) {
+          best = bits;
+          map[c] = i;
+        }
+      }
+    }
+  }
+  return k;
+}
@@ -1,16 +1,45 @@
 #pragma once
 
-#include "node.h"
 #include "code.h"
 #include "defines.h"
+#include <stdbool.h>
 #include <stdint.h>
 
-Node *build_tree(uint64_t hist[static ALPHABET]);
+typedef struct {
+    uint16_t left;      // Index of the left child, NIL for a leaf
+    uint16_t right;     // Index of the right child, NIL for a leaf
+    uint8_t symbol;     // Symbol of a leaf
+    uint64_t frequency; // Frequency of the subtree
+} TreeNode;
 
-void build_codes(Node *root, Code table[static ALPHABET]);
+typedef struct {
+    TreeNode nodes[MAX_NODES]; // Every Node; children come before parents
+    uint16_t size;             // Number of Nodes in use
+    uint16_t root;             // Index of the root, NIL if empty
+} Tree;
 
-void dump_tree(int outfile, Node *root);
+bool build_tree(uint64_t hist[static ALPHABET], Tree *t);
 
-Node *rebuild_tree(uint16_t nbytes, uint8_t tree[static nbytes]);
+void build_codes(Tree *t, Code table[static ALPHABET]);
 
-void delete_tree(Node **root);
+void build_lengths(Tree *t, uint8_t lengths[static ALPHABET]);
+
+bool canonical_codes(uint8_t lengths[static ALPHABET],
+                     Code table[static ALPHABET]);
+
+bool build_limited_lengths(uint64_t hist[static ALPHABET], uint32_t max_len,
+                           uint8_t lengths[static ALPHABET]);
+
+uint16_t pack_lengths(uint8_t lengths[static ALPHABET],
+                      uint8_t buf[static MAX_LENS_SIZE]);
+
+bool unpack_lengths(uint16_t nbytes, uint8_t buf[static nbytes],
+                    uint8_t lengths[static ALPHABET]);
+
+uint16_t dump_tree(Tree *t, uint8_t buf[static MAX_TREE_SIZE]);
+
+bool rebuild_tree(uint16_t nbytes, uint8_t tree[static nbytes], Tree *t);
+
+uint32_t cluster_contexts(uint32_t hist[static ALPHABET][ALPHABET],
+                          uint32_t tables, uint8_t map[static ALPHABET],
+                          uint64_t clusters[][ALPHABET]);
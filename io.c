@@ -3,6 +3,12 @@
 #include "defines.h"	// Defines header file
 
 #include <string.h>     // Used for memset
+#include <errno.h>		// Used for checking interrupted system calls
+#include <sys/mman.h>	// Used for memory mapping files
+#include <sys/stat.h>	// Used for getting the size of a file
+#include <sys/syscall.h>	// Used for copy_file_range, fallocate and vmsplice
+#include <sys/uio.h>	// Used for handing pages to pipes
+#include <linux/falloc.h>	// Used for allocating outfile up front
 #include <fcntl.h>		// Used for file functions
 #include <unistd.h> 	// Used for functions
 #include <stdint.h>		// Declares more integer types
@@ -10,24 +16,33 @@
 #include <stdlib.h>		// Used for macros and functions used in our program
 // clang-format on
 
-// Initializing our stats variables to 0
-uint64_t bytes_read = 0;
-uint64_t bytes_written = 0;
+// Initializing our stats variables to 0; they are atomic since batch mode
+// reads and writes files on several threads at once
+_Atomic uint64_t bytes_read = 0;
+_Atomic uint64_t bytes_written = 0;
+_Atomic uint64_t read_calls = 0;
+_Atomic uint64_t write_calls = 0;
 
 // read_bytes : Wrapper function that reads all nbytes from infile and stores
-// the information in the passed buffer. Returns the number of bytes in our
-// buffer.
+// the information in the passed buffer. Interrupted reads are retried.
+// Returns the number of bytes in our buffer, less than nbytes only at the end
+// of infile, or -1 if a read failed.
 int read_bytes(int infile, uint8_t *buf, int nbytes) {
   int b_read =
       0; // Temp variable to determine how many bytes read per function call
+  ssize_t ret = 0;
   while (b_read != nbytes) { // Read up to the number of bytes specified
-    ssize_t ret = read(
+    ret = read(
         infile, buf + b_read,
         nbytes -
             b_read); // Read and places data into the next free spot in our
                      // passed buffer and only up to the number nbytes (total)
-    if (ret == 0) { // If our call to read() returned 0, there are no more bytes
-                    // to read from infile, break
+    read_calls += 1; // Count every system call for our stats
+    if (ret < 0 && errno == EINTR) { // Interrupted before reading anything
+      continue;
+    }
+    if (ret <= 0) { // If our call to read() returned 0, there are no more
+                    // bytes to read from infile (or it failed), break
       break;
     }
     b_read +=
@@ -36,11 +51,172 @@ int read_bytes(int infile, uint8_t *buf, int nbytes) {
   bytes_read +=
       b_read; // Once we are done reading, increment our stats variable by the
               // number of bytes read in this function call
+  if (ret < 0) { // A failed read is not the end of infile
+    return -1;
+  }
   return b_read; // Return the number of bytes read in this function call
 }
 
+// read_some : Wrapper function that makes a single read() of up to nbytes
+// from infile into buf, so a pipe hands over whatever has arrived instead of
+// blocking until nbytes have. Returns the number of bytes read, 0 at the end
+// of infile, or -1 if the read failed.
+int read_some(int infile, uint8_t *buf, int nbytes) {
+  ssize_t ret = read(infile, buf, nbytes);
+  read_calls += 1; // Count every system call for our stats
+  while (ret < 0 && errno == EINTR) { // Interrupted before reading anything
+    ret = read(infile, buf, nbytes);
+    read_calls += 1;
+  }
+  if (ret < 0) {
+    return -1;
+  }
+  bytes_read += ret; // Increment our stats variable
+  return ret;
+}
+
+// read_at : Wrapper function that reads up to nbytes of infile starting at
+// offset into buf with pread(), leaving the offset of infile alone. Returns
+// the number of bytes read, less than nbytes only at the end of infile or if
+// a read failed.
+int read_at(int infile, uint8_t *buf, int nbytes, uint64_t offset) {
+  int b_read = 0;
+  while (b_read != nbytes) {
+    ssize_t ret = pread(infile, buf + b_read, nbytes - b_read, offset + b_read);
+    read_calls += 1; // Count every system call for our stats
+    if (ret < 0 && errno == EINTR) { // Interrupted before reading anything
+      continue;
+    }
+    if (ret <= 0) { // The end of infile, or it failed
+      break;
+    }
+    b_read += ret;
+  }
+  bytes_read += b_read; // Increment our stats variable
+  return b_read;
+}
+
+// map_input : Function that maps the rest of infile into memory, from its
+// current offset to its end, so it can be read with no copies or system
+// calls. Only regular files can be mapped. Returns the mapped bytes and their
+// count in *size, or NULL if infile can't be mapped and must be read instead.
+uint8_t *map_input(int infile, uint64_t *size) {
+  struct stat s_buff;
+  off_t offset = lseek(infile, 0, SEEK_CUR);
+  if (fstat(infile, &s_buff) < 0 || !S_ISREG(s_buff.st_mode) || offset < 0 ||
+      s_buff.st_size <= offset) {
+    return NULL; // Pipes, sockets and empty files are read instead
+  }
+  off_t skew = offset % sysconf(_SC_PAGESIZE); // Maps start on a page
+  uint64_t length = s_buff.st_size - offset + skew;
+  uint8_t *map = (uint8_t *)mmap(NULL, length, PROT_READ, MAP_PRIVATE, infile,
+                                 offset - skew);
+  if (map == MAP_FAILED) {
+    return NULL;
+  }
+  madvise(map, length, MADV_SEQUENTIAL); // Hints only; read ahead
+#ifdef MADV_HUGEPAGE                     // aggressively and back the
+  madvise(map, length, MADV_HUGEPAGE);   // mapping with huge pages
+#endif                                   // where we can
+  *size = s_buff.st_size - offset;
+  return map + skew;
+}
+
+// unmap_input : Function that unmaps size bytes returned by map_input
+void unmap_input(uint8_t *map, uint64_t size) {
+  uint64_t page = sysconf(_SC_PAGESIZE);
+  uint64_t skew = (uintptr_t)map % page; // map_input started on the page
+  munmap(map - skew, size + skew);       // infile was at
+  return;
+}
+
+// map_output : Function that allocates size more bytes of outfile past its
+// current offset up front, so the file system lays them out in one go, and
+// maps them so they can be written with no copies or system calls. Only
+// regular files opened for reading and writing can be mapped. Returns the
+// mapped bytes, or NULL if outfile can't be mapped or the space can't be
+// reserved and it must be written instead. File systems that can't reserve
+// space at all are still mapped.
+uint8_t *map_output(int outfile, uint64_t size) {
+  struct stat s_buff;
+  off_t offset = lseek(outfile, 0, SEEK_CUR);
+  if (fstat(outfile, &s_buff) < 0 || !S_ISREG(s_buff.st_mode) || offset < 0 ||
+      size == 0) {
+    return NULL; // Pipes, sockets and empty outputs are written instead
+  }
+  if (syscall(__NR_fallocate, outfile, FALLOC_FL_KEEP_SIZE, offset, size) <
+          0 &&
+      errno != EOPNOTSUPP) {
+    return NULL; // A full disk would kill us with SIGBUS; write() reports it
+  }
+  if ((fcntl(outfile, F_GETFL) & O_ACCMODE) != O_RDWR ||
+      ftruncate(outfile, offset + size) < 0) {
+    return NULL;
+  }
+  off_t skew = offset % sysconf(_SC_PAGESIZE); // Maps start on a page
+  uint8_t *map = (uint8_t *)mmap(NULL, size + skew, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED, outfile, offset - skew);
+  if (map == MAP_FAILED) {
+    ftruncate(outfile, offset);
+    return NULL;
+  }
+  madvise(map, size + skew, MADV_SEQUENTIAL);
+  return map + skew;
+}
+
+// unmap_output : Function that unmaps size bytes returned by map_output, of
+// which only the first used were written, and cuts outfile off after them
+// with its offset at its end
+void unmap_output(int outfile, uint8_t *map, uint64_t size, uint64_t used) {
+  unmap_input(map, size);
+  off_t offset = lseek(outfile, 0, SEEK_CUR);
+  if (used < size) { // Decoding stopped short
+    ftruncate(outfile, offset + used);
+  }
+  lseek(outfile, used, SEEK_CUR);
+  bytes_written += used; // Count mapped bytes as written to keep stats right
+  return;
+}
+
+// gift_alloc : Function that maps size bytes of fresh pages, to be filled
+// and handed to a pipe by gift_bytes. Returns NULL if error.
+uint8_t *gift_alloc(uint32_t size) {
+  uint8_t *buf = (uint8_t *)mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE,
+                                 -1, 0);
+  return buf == MAP_FAILED ? NULL : buf;
+}
+
+// gift_bytes : Function that writes the first nbytes of buf, size bytes from
+// gift_alloc, to the pipe outfile by handing it the pages of buf with
+// vmsplice() instead of copying them, then unmaps buf. The pipe's reader may
+// still be reading the pages, so they are never written again. Anything
+// vmsplice() can't take is written. Returns the number of bytes written.
+int gift_bytes(int outfile, uint8_t *buf, uint32_t size, int nbytes) {
+  int b_write = 0;
+  while (b_write < nbytes) {
+    struct iovec iov = {buf + b_write, nbytes - b_write};
+    ssize_t ret = syscall(__NR_vmsplice, outfile, &iov, 1, 0);
+    write_calls += 1; // Count every system call for our stats
+    if (ret < 0 && errno == EINTR) { // Interrupted before handing anything
+      continue;
+    }
+    if (ret <= 0) { // Not a pipe after all, or it failed
+      break;
+    }
+    b_write += ret;
+    bytes_written += ret;
+  }
+  if (b_write < nbytes) {
+    b_write += write_bytes(outfile, buf + b_write, nbytes - b_write);
+  }
+  munmap(buf, size);
+  return b_write;
+}
+
 // write_bytes : Wrapper function that writes all nbytes from the buf to our
-// file outfile. Returns the number of bytes written.
+// file outfile. Interrupted writes are retried. Returns the number of bytes
+// written, less than nbytes only if a write failed.
 int write_bytes(int outfile, uint8_t *buf, int nbytes) {
   int b_write =
       0; // Temp variable to determine how many bytes written per function call
@@ -49,8 +225,12 @@ int write_bytes(int outfile, uint8_t *buf, int nbytes) {
         write(outfile, buf + b_write,
               nbytes - b_write); // Write from the next data from our buffer and
                                  // only up to the number nbytes (total)
-    if (ret == 0) { // If our call to write() returned 0, there are no more
-                    // bytes to write to outfile, break
+    write_calls += 1; // Count every system call for our stats
+    if (ret < 0 && errno == EINTR) { // Interrupted before writing anything
+      continue;
+    }
+    if (ret <= 0) { // If our call to write() returned 0, there are no more
+                    // bytes to write to outfile (or it failed), break
       break;
     }
     b_write +=
@@ -62,75 +242,319 @@ int write_bytes(int outfile, uint8_t *buf, int nbytes) {
   return b_write; // Return the number of bytes written in this function call
 }
 
-static uint8_t r_buf =
-    '\0'; // 1 Byte Buffer that gets contents from read_bytes and used in
-          // read_bit to get individual bits from infile
-static int read_bit_idx = 0; // Temp varbiable that indicates the current index
-                             // of what bit to read from r_buf
-static int read_byte_max =
-    0; // Temp variable to hold the number of bytes in r_buf
-
-// Got how to set/clear/get a bit from:
-// https://stackoverflow.com/questions/47981/how-do-i-set-clear-and-toggle-a-single-bit
-
-// read_bit : Function that reads out bits from a block of bytes which is
-// collected from an infile
-bool read_bit(int infile, uint8_t *bit) {
-  if (read_bit_idx ==
-      read_byte_max * 8) { // We are at the end of reading bits from r_buf
-    read_byte_max = read_bytes(infile, &r_buf, 1); // Refill r_buf from infile
-    read_bit_idx = 0;                              // Reset our bit index
-    if (read_byte_max ==
-        0) { // If the return value from read_bytes == 0; there are no more
-             // bytes to read from infile, thus no more bits; return 0.
-      return 0;
-    }
-  }
-  uint8_t bit_num =
-      read_bit_idx %
-      8; // Finds the corresponding 'bit' the bit is in within r_buf
-  *bit = (r_buf >> bit_num) & 1; // Gets the bit
-  read_bit_idx += 1; // Increment out bit index counter for read_bit()
+// copy_bytes : Function that copies nbytes from infile to outfile, starting
+// at the current offset of each. The bytes are moved in the kernel with
+// copy_file_range() where it supports both files, and through a buffer
+// otherwise (pipes, older kernels). Returns the number of bytes copied, less
+// than nbytes only if infile ended or a read or write failed.
+uint64_t copy_bytes(int infile, int outfile, uint64_t nbytes) {
+  uint64_t copied = 0;
+  ssize_t ret = 0;
+  while (copied < nbytes) { // Never copies the bytes into our memory
+    uint64_t want = nbytes - copied < COPY_SIZE ? nbytes - copied : COPY_SIZE;
+    ret = syscall(__NR_copy_file_range, infile, NULL, outfile, NULL, want, 0);
+    write_calls += 1; // Count every system call for our stats
+    if (ret < 0 && errno == EINTR) { // Interrupted before copying anything
+      continue;
+    }
+    if (ret <= 0) { // The end of infile, or these files can't be copied
+      break;        // in the kernel
+    }
+    copied += ret;
+    bytes_read += ret; // Count the bytes as read and written for our stats
+    bytes_written += ret;
+  }
+  uint8_t buff[IO_BLOCK]; // Buffer for the bytes the kernel can't copy
+  while (ret < 0 && copied < nbytes) {
+    int want = nbytes - copied < IO_BLOCK ? nbytes - copied : IO_BLOCK;
+    int n = read_bytes(infile, buff, want);
+    if (n < 0) { // Our copy comes up short
+      break;
+    }
+    int w = write_bytes(outfile, buff, n);
+    copied += w;
+    if (n < want || w < n) { // infile ended, or a write failed
+      break;
+    }
+  }
+  return copied;
+}
+
+// br_init : Function that sets up a Bit Reader. With fd >= 0, buf is a
+// scratch buffer of size bytes that is refilled from fd. With fd < 0, buf
+// already holds the size bytes to read bits from.
+void br_init(BitReader *r, int fd, uint8_t *buf, uint64_t size) {
+  r->fd = fd;
+  r->buf = buf;
+  r->cap = size;
+  r->pos = 0;
+  r->end = fd < 0 ? size : 0; // A file backed buffer starts out empty
+  r->acc = 0;
+  r->bits = 0;
+  r->stage = NULL;
+  return;
+}
+
+// br_init_stage : Function that sets up a Bit Reader that reads the buffers
+// of a reader Stage, so the file is read on another thread ahead of us
+void br_init_stage(BitReader *r, Stage *stage) {
+  br_init(r, -1, NULL, 0);
+  r->stage = stage;
+  return;
+}
+
+// br_refill : Helper function that refills the empty buffer of a file or
+// Stage backed Bit Reader. Leaves it empty at the end of the input.
+static void br_refill(BitReader *r) {
+  if (r->stage != NULL) { // Swap our buffer for the next one read
+    if (r->buf != NULL) {
+      stage_put(r->stage, r->buf, 0);
+    }
+    uint32_t n = 0;
+    r->buf = stage_get(r->stage, &n);
+    r->end = n;
+  } else {
+    int n = read_some(r->fd, r->buf, r->cap);
+    r->end = n > 0 ? n : 0; // Our reader can't go on either way
+  }
+  r->pos = 0;
+  return;
+}
+
+// br_top_up : Helper function that tops up the bit accumulator of a Bit
+// Reader, refilling its buffer from its file a whole buffer at a time. The
+// file is only waited on while we hold fewer than want bits, so a pipe is
+// never waited on for bits nobody asked for yet.
+static void br_top_up(BitReader *r, uint32_t want) {
+  if (r->end - r->pos >= 8) { // Fast path: load 8 bytes at once. Bytes past
+    uint64_t word;            // the ones we keep land on the same bits they
+    memcpy(&word, r->buf + r->pos, 8); // will be loaded into next time.
+    r->acc |= word << r->bits;
+    uint32_t n = (63 - r->bits) / 8; // Whole bytes that fit in acc
+    r->pos += n;
+    r->bits += 8 * n;
+    return;
+  }
+  while (r->bits <= 56) { // Only refill while a whole byte still fits
+    if (r->pos == r->end) { // Our buffer is empty, refill it from our file
+      if ((r->fd < 0 && r->stage == NULL) || r->bits >= want) {
+        break;
+      }
+      br_refill(r);
+      if (r->end == 0) { // No more bytes to read
+        break;
+      }
+    }
+    r->acc |= (uint64_t)r->buf[r->pos] << r->bits; // Place the byte above
+    r->pos += 1;                                   // our bits
+    r->bits += 8;
+  }
+  return;
+}
+
+// br_fill : Function that tops up the bit accumulator of a Bit Reader with
+// at least 32 bits, unless the input runs out first
+void br_fill(BitReader *r) {
+  br_top_up(r, 32);
+  return;
+}
+
+// br_peek : Function that returns the next nbits (at most 32) bits of a Bit
+// Reader without consuming them. The first bit is placed in bit 0 of the
+// result; bits past the end of the input read as 0.
+uint32_t br_peek(BitReader *r, uint32_t nbits) {
+  if (r->bits < nbits) { // Only touch our buffer if we are short on bits
+    br_top_up(r, nbits);
+  }
+  return r->acc & ((1ULL << nbits) - 1);
+}
+
+// br_skip : Function that consumes nbits bits previously seen with br_peek.
+// Returns FALSE/0 if fewer than nbits bits were left.
+bool br_skip(BitReader *r, uint32_t nbits) {
+  if (nbits > r->bits) { // We ran off the end of our input
+    r->acc = 0;
+    r->bits = 0;
+    return 0;
+  }
+  r->acc >>= nbits;
+  r->bits -= nbits;
   return 1;
 }
 
-static uint8_t w_buf =
-    '\0'; // 1 Byte Buffer that writes its contents to outfile and used in
-          // write_code to set the individual bits of the buffer
-static int write_bit_idx = 0; // Temp varbiable that indicates the current index
-                              // of of what bit to write to in w_buf
-
-// write_code : Function that writes out bits from a Code to outfile with the
-// use of a buffer
-void write_code(int outfile, Code *c) {
-  for (uint32_t i = 0; i < code_size(c);
-       i += 1) { // Iterate through the bits of the passed Code
-    if (write_bit_idx == 8) {
-      write_bytes(outfile, &w_buf,
-                  1); // If our buffer is full, write the buffer to outfile
-      memset(&w_buf, 0, 1);
-      write_bit_idx = 0; // Reset out bit index
-    }
-    uint8_t bit_num =
-        write_bit_idx %
-        8; // Finds the corresponding 'bit' the bit is in within the 'block'
-    if (code_get_bit(c, i)) {
-      w_buf =
-          w_buf | (1UL << bit_num); // If the bit at index i from our Code is 1,
-                                    // set the buffer at our bit index to 1
-    } // We dont have to worry about if the Code at index i is 0 because if it
-      // is, the buffer at our bit index is already 0
-    write_bit_idx += 1; // Increment our bit index counter for write_codes()
+// br_read_bytes : Function that reads up to n whole bytes from a Bit Reader
+// into buf, first dropping any bits left over from a partial byte. Lets
+// headers and bitstreams share one buffered reader. Returns the number of
+// bytes read, less than n only at the end of the input.
+uint32_t br_read_bytes(BitReader *r, uint8_t *buf, uint32_t n) {
+  uint32_t got = 0;
+  r->acc >>= r->bits % 8; // Align to a whole byte
+  r->bits -= r->bits % 8;
+  while (got < n && r->bits > 0) { // Bytes already in our accumulator
+    buf[got] = r->acc & 0xFF;
+    got += 1;
+    r->acc >>= 8;
+    r->bits -= 8;
+  }
+  if (r->bits == 0) { // Forget bytes peeked past our accumulator; they are
+    r->acc = 0;       // about to be handed out from buf instead
   }
+  while (got < n) {
+    if (r->pos == r->end) { // Our buffer is empty
+      if (r->fd < 0 && r->stage == NULL) {
+        break;
+      }
+      if (r->stage == NULL && n - got >= r->cap) { // Large reads go straight
+        int k = read_bytes(r->fd, buf + got, n - got); // into buf
+        got += k > 0 ? k : 0;
+        break;
+      }
+      br_refill(r);
+      if (r->end == 0) { // No more bytes to read
+        break;
+      }
+    }
+    uint32_t k = r->end - r->pos < n - got ? r->end - r->pos : n - got;
+    memcpy(buf + got, r->buf + r->pos, k);
+    r->pos += k;
+    got += k;
+  }
+  return got;
+}
+
+// br_view : Function that hands out the next n whole bytes of a memory
+// backed Bit Reader without copying them. Returns NULL if the reader is file
+// or Stage backed, holds leftover bits, or has fewer than n bytes left.
+uint8_t *br_view(BitReader *r, uint32_t n) {
+  if (r->fd >= 0 || r->stage != NULL || r->bits > 0 || r->end - r->pos < n) {
+    return NULL;
+  }
+  uint8_t *view = r->buf + r->pos;
+  r->pos += n;
+  return view;
+}
+
+// bw_init : Function that sets up a Bit Writer. With fd >= 0, buf is a
+// scratch buffer of size bytes that is written to fd whenever it fills up.
+// With fd < 0, the bits are collected in buf, which must be large enough.
+void bw_init(BitWriter *w, int fd, uint8_t *buf, uint32_t size) {
+  w->fd = fd;
+  w->buf = buf;
+  w->cap = size;
+  w->pos = 0;
+  w->acc = 0;
+  w->bits = 0;
+  w->stage = NULL;
   return;
 }
 
-// flush_codes : Function that writes out extra leftover bits in our buffer
-void flush_codes(int outfile) {
-  // Fill up the extra bits in our buffer with 0
-  for (uint32_t i = write_bit_idx; i < 8; i += 1) {
-    w_buf = w_buf & ~(1UL << i);
+// bw_init_stage : Function that sets up a Bit Writer that fills the buffers
+// of a writer Stage, so they are written out on another thread while we go
+// on. Returns once the Stage hands us our first buffer.
+void bw_init_stage(BitWriter *w, Stage *stage) {
+  uint32_t n = 0;
+  uint8_t *buf = stage_get(stage, &n);
+  bw_init(w, -1, buf, n);
+  w->stage = stage;
+  return;
+}
+
+// bw_spill : Helper function that writes out the buffer of a file or Stage
+// backed Bit Writer and empties it
+static void bw_spill(BitWriter *w) {
+  if (w->stage != NULL) { // Hand our buffer over, and go on in the next one
+    stage_put(w->stage, w->buf, w->pos);
+    w->buf = stage_get(w->stage, &w->cap);
+  } else {
+    write_bytes(w->fd, w->buf, w->pos);
+  }
+  w->pos = 0;
+  return;
+}
+
+// bw_drain : Helper function that moves every whole byte from the bit
+// accumulator of a Bit Writer into its buffer
+static void bw_drain(BitWriter *w) {
+  if (w->cap - w->pos >= 8) { // Fast path: store all 8 bytes at once
+    uint32_t n = w->bits / 8;
+    memcpy(w->buf + w->pos, &w->acc, 8);
+    w->pos += n;
+    w->acc = n == 8 ? 0 : w->acc >> (8 * n);
+    w->bits -= 8 * n;
+    return;
+  }
+  while (w->bits >= 8) {
+    if (w->pos == w->cap) { // Our buffer is full, write it to our file
+      if (w->fd < 0 && w->stage == NULL) {
+        return; // Out of room in memory; our caller sized buf too small
+      }
+      bw_spill(w);
+    }
+    w->buf[w->pos] = w->acc & 0xFF;
+    w->pos += 1;
+    w->acc >>= 8;
+    w->bits -= 8;
+  }
+  return;
+}
+
+// bw_write_code : Function that writes out the bits of a Code
+void bw_write_code(BitWriter *w, Code *c) {
+  uint32_t size = code_size(c);
+  for (uint32_t i = 0; i < size; i += 8) { // Code bits are stored in the same
+                                           // order we write them, so append
+                                           // them up to a byte at a time
+    uint32_t n = (size - i) < 8 ? (size - i) : 8;
+    if (w->bits > 56) { // Make room in our accumulator
+      bw_drain(w);
+    }
+    w->acc |= (uint64_t)(c->bits[i / 8] & ((1U << n) - 1)) << w->bits;
+    w->bits += n;
   }
-  write_bytes(outfile, &w_buf, 1); // Write the current buffer to outfile
   return;
 }
+
+// bw_write_bits : Function that writes out the low nbits (at most 32) bits of
+// bits, bit 0 first
+void bw_write_bits(BitWriter *w, uint64_t bits, uint32_t nbits) {
+  if (w->bits > 32) { // Make room in our accumulator
+    bw_drain(w);
+  }
+  w->acc |= bits << w->bits;
+  w->bits += nbits;
+  return;
+}
+
+// bw_sync : Function that writes out every whole byte a file backed Bit
+// Writer holds, keeping the bits of a partial byte for later, so the output
+// keeps up with the input without any padding
+void bw_sync(BitWriter *w) {
+  bw_drain(w);
+  if ((w->fd >= 0 || w->stage != NULL) && w->pos > 0) {
+    bw_spill(w);
+  }
+  return;
+}
+
+// bw_flush : Function that pads the last partial byte with 0 bits and, for a
+// file backed Bit Writer, writes out its buffer. A Stage backed Bit Writer
+// hands its last buffer back to its Stage. Returns the number of bytes left
+// in the buffer, which is the size of the output for a memory writer.
+uint32_t bw_flush(BitWriter *w) {
+  if (w->bits > 0) { // Round up to a whole byte
+    w->bits = (w->bits + 7) / 8 * 8;
+  }
+  bw_drain(w);
+  w->acc = 0;
+  w->bits = 0;
+  if (w->fd >= 0) {
+    write_bytes(w->fd, w->buf, w->pos); // Write the current buffer to our file
+    w->pos = 0;
+  } else if (w->stage != NULL) {
+    stage_put(w->stage, w->buf, w->pos);
+    w->buf = NULL;
+    w->cap = 0;
+    w->pos = 0;
+  }
+  return w->pos;
+}
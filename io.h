@@ -1,18 +1,80 @@
 #pragma once
 
 #include "code.h"
+#include "stage.h"
 #include <stdbool.h>
 #include <stdint.h>
 
-extern uint64_t bytes_read;
-extern uint64_t bytes_written;
+typedef struct {
+    int fd;        // File buf is refilled from, or -1 for a memory buffer
+    uint8_t *buf;  // Bytes bits are read from
+    uint64_t cap;  // Size of buf
+    uint64_t pos;  // Index of the next unread byte in buf
+    uint64_t end;  // Number of valid bytes in buf
+    uint64_t acc;  // Bit accumulator; the next bit to read is bit 0
+    uint32_t bits; // Number of valid bits in acc
+    Stage *stage;  // Reader Stage buf comes from, or NULL
+} BitReader;
+
+typedef struct {
+    int fd;        // File buf is written to, or -1 for a memory buffer
+    uint8_t *buf;  // Bytes bits are written to
+    uint32_t cap;  // Size of buf
+    uint32_t pos;  // Number of bytes in buf
+    uint64_t acc;  // Bit accumulator; bit 0 is written first
+    uint32_t bits; // Number of bits in acc
+    Stage *stage;  // Writer Stage buf goes to, or NULL
+} BitWriter;
+
+extern _Atomic uint64_t bytes_read;
+extern _Atomic uint64_t bytes_written;
+extern _Atomic uint64_t read_calls;
+extern _Atomic uint64_t write_calls;
 
 int read_bytes(int infile, uint8_t *buf, int nbytes);
 
+int read_some(int infile, uint8_t *buf, int nbytes);
+
+int read_at(int infile, uint8_t *buf, int nbytes, uint64_t offset);
+
+uint8_t *map_input(int infile, uint64_t *size);
+
+void unmap_input(uint8_t *map, uint64_t size);
+
+uint8_t *map_output(int outfile, uint64_t size);
+
+void unmap_output(int outfile, uint8_t *map, uint64_t size, uint64_t used);
+
+uint8_t *gift_alloc(uint32_t size);
+
+int gift_bytes(int outfile, uint8_t *buf, uint32_t size, int nbytes);
+
 int write_bytes(int outfile, uint8_t *buf, int nbytes);
 
-bool read_bit(int infile, uint8_t *bit);
+uint64_t copy_bytes(int infile, int outfile, uint64_t nbytes);
+
+void br_init(BitReader *r, int fd, uint8_t *buf, uint64_t size);
+
+void br_init_stage(BitReader *r, Stage *stage);
+
+void br_fill(BitReader *r);
+
+uint32_t br_peek(BitReader *r, uint32_t nbits);
+
+bool br_skip(BitReader *r, uint32_t nbits);
+
+uint32_t br_read_bytes(BitReader *r, uint8_t *buf, uint32_t n);
+
+uint8_t *br_view(BitReader *r, uint32_t n);
+
+void bw_init(BitWriter *w, int fd, uint8_t *buf, uint32_t size);
+
+void bw_init_stage(BitWriter *w, Stage *stage);
+
+void bw_write_code(BitWriter *w, Code *c);
+
+void bw_write_bits(BitWriter *w, uint64_t bits, uint32_t nbits);
 
-void write_code(int outfile, Code *c);
+void bw_sync(BitWriter *w);
 
-void flush_codes(int outfile);
+uint32_t bw_flush(BitWriter *w);
@@ -0,0 +1,183 @@
+// clang-format off
+#include "pool.h"		// Pool header file
+
+#include <pthread.h>	// Used for threads, mutexes and condition variables
+#include <stdint.h>		// Declares more integer types
+#include <stdio.h>		// Used for input and output for our program
+#include <stdlib.h>		// Used for macros and functions used in our program
+// clang-format on
+
+// A Pool is a fixed set of worker threads that run submitted Jobs in the
+// order they were submitted. pool_wait() blocks until every submitted Job
+// has finished. A Job can also be tracked on its own through a done flag,
+// which lets callers write results back in order as soon as they are ready.
+
+// Task Struct, a submitted Job waiting in our queue
+typedef struct Task Task;
+
+struct Task {
+  Job job;
+  void *arg;
+  bool *done; // Set once the Job has finished, may be NULL
+  Task *next;
+};
+
+// Pool Struct
+struct Pool {
+  pthread_t *workers;    // Our worker threads
+  uint32_t threads;      // Number of worker threads
+  Task *head;            // Next Task to run
+  Task *tail;            // Last Task submitted
+  uint32_t pending;      // Tasks submitted but not finished yet
+  bool stop;             // Set when our workers should exit
+  pthread_mutex_t lock;  // Guards every field above
+  pthread_cond_t work;   // Signaled when a Task is queued or on stop
+  pthread_cond_t idle;   // Signaled whenever a Task finishes
+};
+
+// pool_worker : Helper function that each worker thread runs. Takes Tasks off
+// our queue until the Pool is stopped.
+static void *pool_worker(void *arg) {
+  Pool *p = (Pool *)arg;
+  pthread_mutex_lock(&p->lock);
+  while (1) {
+    while (p->head == NULL && !p->stop) { // Sleep until there is work
+      pthread_cond_wait(&p->work, &p->lock);
+    }
+    if (p->head == NULL) { // Stopped and nothing left to run
+      break;
+    }
+    Task *t = p->head; // Dequeue the next Task
+    p->head = t->next;
+    if (p->head == NULL) {
+      p->tail = NULL;
+    }
+    pthread_mutex_unlock(&p->lock);
+    t->job(t->arg); // Run the Job without holding our lock
+    pthread_mutex_lock(&p->lock);
+    if (t->done != NULL) {
+      *t->done = 1;
+    }
+    free(t);
+    p->pending -= 1;
+    pthread_cond_broadcast(&p->idle);
+  }
+  pthread_mutex_unlock(&p->lock);
+  return NULL;
+}
+
+// pool_create : Constructor for a Pool of threads worker threads (at least
+// 1). Returns the created Pool or NULL if error.
+Pool *pool_create(uint32_t threads) {
+  Pool *p = (Pool *)malloc(sizeof(Pool));
+  if (p != NULL) { // If malloc worked for our Pool
+    if (threads == 0) {
+      threads = 1;
+    }
+    p->workers = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    if (p->workers == NULL) {
+      free(p);
+      p = NULL;
+      return p;
+    }
+    p->threads = 0;
+    p->head = NULL;
+    p->tail = NULL;
+    p->pending = 0;
+    p->stop = 0;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->work, NULL);
+    pthread_cond_init(&p->idle, NULL);
+    for (uint32_t i = 0; i < threads; i += 1) { // Start our workers
+      if (pthread_create(&p->workers[i], NULL, pool_worker, p) != 0) {
+        break;
+      }
+      p->threads += 1;
+    }
+    if (p->threads == 0) { // Not a single worker could be started
+      pool_delete(&p);
+    }
+  }
+  return p; // Returns Null if not created correctly, else returns the Pool
+}
+
+// pool_delete : Function that finishes every submitted Job, stops our
+// workers and deletes the Pool
+void pool_delete(Pool **p) {
+  pthread_mutex_lock(&(*p)->lock);
+  (*p)->stop = 1;
+  pthread_cond_broadcast(&(*p)->work); // Wake every worker so they can exit
+  pthread_mutex_unlock(&(*p)->lock);
+  for (uint32_t i = 0; i < (*p)->threads; i += 1) {
+    pthread_join((*p)->workers[i], NULL);
+  }
+  pthread_mutex_destroy(&(*p)->lock);
+  pthread_cond_destroy(&(*p)->work);
+  pthread_cond_destroy(&(*p)->idle);
+  free((*p)->workers); // Frees our workers
+  (*p)->workers = NULL;
+  free(*p); // Frees our Pool
+  (*p) = NULL;
+  return;
+}
+
+// pool_threads : Function that returns the number of worker threads
+uint32_t pool_threads(Pool *p) { return p->threads; }
+
+// pool_submit : Function that queues job to be run with arg on one of our
+// workers. If done is not NULL it is cleared now and set once the job has
+// finished. Returns FALSE/0 if error.
+bool pool_submit(Pool *p, Job job, void *arg, bool *done) {
+  Task *t = (Task *)malloc(sizeof(Task));
+  if (t == NULL) {
+    return 0;
+  }
+  t->job = job;
+  t->arg = arg;
+  t->done = done;
+  t->next = NULL;
+  pthread_mutex_lock(&p->lock);
+  if (done != NULL) {
+    *done = 0;
+  }
+  if (p->tail == NULL) { // Enqueue at the tail of our queue
+    p->head = t;
+  } else {
+    p->tail->next = t;
+  }
+  p->tail = t;
+  p->pending += 1;
+  pthread_cond_signal(&p->work); // Wake up one worker
+  pthread_mutex_unlock(&p->lock);
+  return 1;
+}
+
+// pool_wait : Function that waits until every submitted Job has finished
+void pool_wait(Pool *p) {
+  pthread_mutex_lock(&p->lock);
+  while (p->pending > 0) {
+    pthread_cond_wait(&p->idle, &p->lock);
+  }
+  pthread_mutex_unlock(&p->lock);
+  return;
+}
+
+// pool_finished : Function that returns TRUE/1 if the job tracked by done
+// has finished. Never blocks.
+bool pool_finished(Pool *p, bool *done) {
+  pthread_mutex_lock(&p->lock);
+  bool ret = *done;
+  pthread_mutex_unlock(&p->lock);
+  return ret;
+}
+
+// pool_wait_for : Function that waits until the job tracked by done has
+// finished
+void pool_wait_for(Pool *p, bool *done) {
+  pthread_mutex_lock(&p->lock);
+  while (!*done) {
+    pthread_cond_wait(&p->idle, &p->lock);
+  }
+  pthread_mutex_unlock(&p->lock);
+  return;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef void (*Job)(void *arg);
+
+typedef struct Pool Pool;
+
+Pool *pool_create(uint32_t threads);
+
+void pool_delete(Pool **p);
+
+uint32_t pool_threads(Pool *p);
+
+bool pool_submit(Pool *p, Job job, void *arg, bool *done);
+
+void pool_wait(Pool *p);
+
+bool pool_finished(Pool *p, bool *done);
+
+void pool_wait_for(Pool *p, bool *done);
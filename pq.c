@@ -1,49 +1,74 @@
 // clang-format off
 #include "pq.h"			// PQ header file
-#include "node.h"		// Node header file
+#include "huffman.h"	// Huffman header file
 
+#include <ctype.h>		// Used for printing a Node's symbol
 #include <stdint.h>		// Declares more integer types
 #include <stdio.h>		// Used for input and output for our program
 #include <stdlib.h>		// Used for macros and functions used in our program
 // clang-format on
 
-// Using a Insertion Sort for our Priority Queue
-// Used the following link to understand how to use Insertion Sort:
-// https://www.youtube.com/watch?v=JU767SDMDvA
-
-void insertion_sort(Node **arr, uint32_t size) {
-  uint32_t i, j;
-  for (i = 1; i < size;
-       i +=
-       1) { // Iterate through all the elemtents in array (starting at index 1)
-    j = i;  // Start j from i
-    while (j > 0 &&
-           node_cmp(arr[j - 1],
-                    arr[j])) { // While node at j - 1 > j , we swap them
-      Node *temp = arr[j];
-      arr[j] = arr[j - 1];
-      arr[j - 1] = temp;
-      j -= 1; // Go through all j from [i->0]
-    }
-  }
-  return;
-}
+// Using a binary min-heap of the Nodes of a Tree for our Priority Queue:
+// arr[0] holds the Node with the lowest frequency and the children of arr[i]
+// are arr[2i+1] and arr[2i+2], so enqueue and dequeue each take O(log n)
+// swaps.
 
 typedef struct PriorityQueue PriorityQueue;
 
-// Priority Queue Struct, using Insertion Sort
+// Priority Queue Struct, using a binary min-heap
 struct PriorityQueue {
-  Node **arr;        // Array implementation
+  TreeNode **arr;    // Array implementation
   uint32_t capacity; // Max capacity of our PQ
   uint32_t size;     // Current size of our PQ
 };
 
-// pq_create: Function that creates our PQ which utilizes insertion sort
+// node_cmp : Helper function that returns TRUE/1 if n's frequency is more
+// than m's frequency
+static bool node_cmp(TreeNode *n, TreeNode *m) {
+  return n->frequency > m->frequency;
+}
+
+// swap : Helper function that swaps two entries of our heap
+static void swap(TreeNode **arr, uint32_t i, uint32_t j) {
+  TreeNode *temp = arr[i];
+  arr[i] = arr[j];
+  arr[j] = temp;
+  return;
+}
+
+// sift_up : Helper function that moves the Node at index i up until its parent
+// is no larger
+static void sift_up(TreeNode **arr, uint32_t i) {
+  while (i > 0 && node_cmp(arr[(i - 1) / 2], arr[i])) { // Parent is larger
+    swap(arr, i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+  return;
+}
+
+// sift_down : Helper function that moves the Node at index i down until
+// neither of its children is smaller
+static void sift_down(TreeNode **arr, uint32_t size, uint32_t i) {
+  while (2 * i + 1 < size) {
+    uint32_t child = 2 * i + 1; // Pick the smaller of our two children
+    if (child + 1 < size && node_cmp(arr[child], arr[child + 1])) {
+      child += 1;
+    }
+    if (!node_cmp(arr[i], arr[child])) { // Already in heap order
+      break;
+    }
+    swap(arr, i, child);
+    i = child;
+  }
+  return;
+}
+
+// pq_create: Function that creates our PQ which utilizes a binary min-heap
 PriorityQueue *pq_create(uint32_t capacity) {
   PriorityQueue *q = (PriorityQueue *)malloc(sizeof(PriorityQueue));
   if (q != NULL) { // If malloc worked for our PQ
-    q->arr = (Node **)malloc(capacity *
-                             sizeof(Node)); // malloc space for our min array
+    q->arr = (TreeNode **)malloc(
+        capacity * sizeof(TreeNode *)); // malloc space for our heap
     if (q->arr == NULL) {
       free(q);
       q = NULL;
@@ -87,34 +112,38 @@ bool pq_full(PriorityQueue *q) {
 
 // enqueue: Function that enqueues a Node n to our PQ. Returns FALSE/0 if any
 // error, Else returns TRUE/1
-bool enqueue(PriorityQueue *q, Node *n) {
+bool enqueue(PriorityQueue *q, TreeNode *n) {
   if (pq_full(q)) { // If full, cant enqueue anything
     return 0;
   }
-  q->arr[q->size] = n;             // Place our node
-  q->size += 1;                    // Increment size
-  insertion_sort(q->arr, q->size); // Sort our array
+  q->arr[q->size] = n;          // Place our node at the bottom of our heap
+  q->size += 1;                 // Increment size
+  sift_up(q->arr, q->size - 1); // Restore heap order
   return 1;
 }
 
 // dequeue: Function that dequeues a Node n to our PQ. Returns FALSE/0 if any
 // error, Else returns TRUE/1
-bool dequeue(PriorityQueue *q, Node **n) {
+bool dequeue(PriorityQueue *q, TreeNode **n) {
   if (pq_empty(q)) { // If empty, cant dequeue anything
     return 0;
   }
   *n = q->arr[0];                  // Get our node
   q->arr[0] = q->arr[q->size - 1]; // Replace node at arr[0]
   q->size -= 1;                    // Decrease size
-  insertion_sort(q->arr, q->size); // Sort our array
+  sift_down(q->arr, q->size, 0);   // Restore heap order
   return 1;
 }
 
-// pq_print: Function that prints our array
+// pq_print: Function that prints our heap array, in heap order
 void pq_print(PriorityQueue *q) {
   for (uint32_t i = 0; i < q->size; i += 1) { // Traverse array, print each node
-    printf("Index: %d, Node: ", i);
-    node_print(q->arr[i]);
+    TreeNode *n = q->arr[i];
+    if (n->left == NIL && isprint(n->symbol)) { // Leaves print their symbol
+      printf("Index: %u, Node: %c: %lu\n", i, n->symbol, n->frequency);
+    } else {
+      printf("Index: %u, Node: (Not Printable): %lu\n", i, n->frequency);
+    }
   }
   return;
 }
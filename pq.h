@@ -1,6 +1,6 @@
 #pragma once
 
-#include "node.h"
+#include "huffman.h"
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -16,8 +16,8 @@ bool pq_full(PriorityQueue *q);
 
 uint32_t pq_size(PriorityQueue *q);
 
-bool enqueue(PriorityQueue *q, Node *n);
+bool enqueue(PriorityQueue *q, TreeNode *n);
 
-bool dequeue(PriorityQueue *q, Node **n);
+bool dequeue(PriorityQueue *q, TreeNode **n);
 
 void pq_print(PriorityQueue *q);
@@ -0,0 +1,336 @@
+// clang-format off
+#include "stage.h"		// Stage header file
+#include "uring.h"		// Uring header file
+#include "io.h"			// IO header file
+#include "defines.h"	// Defines header file
+
+#include <errno.h>		// Used for retrying interrupted IO
+#include <pthread.h>	// Used for threads
+#include <semaphore.h>	// Used for sleeping until a Ring has a Slot
+#include <stdint.h>		// Declares more integer types
+#include <stdlib.h>		// Used for macros and functions used in our program
+#include <sys/stat.h>	// Used for telling regular files apart
+#include <unistd.h>		// Used for lseek
+// clang-format on
+
+// A Stage is a thread that does the reading or the writing of a file for
+// whoever is coding it, so IO and compute overlap. A reader Stage fills
+// STAGE_BUFFERS buffers of STAGE_SIZE bytes with read() ahead of its caller;
+// a writer Stage writes out the buffers its caller hands it while the caller
+// fills the next one. Buffers go back and forth between the two threads on
+// two single producer, single consumer Rings: full ones one way, empty ones
+// the other. Each Ring has one thread pushing and one popping, so each index
+// is only ever moved by one side; a semaphore counts the Slots in it, and
+// its post and wait are what hand a pushed Slot over to the popping thread,
+// which sleeps on it instead of spinning while IO is slow.
+//
+// Regular files skip the thread where io_uring is available: a Uring keeps
+// a read or write in flight on every buffer at once, each at its own file
+// offset, and the caller only waits on the kernel when the buffer it needs
+// next is not done yet. Reads and writes that come up short are resubmitted
+// for the rest. Buffers are handed out and back in order, so the oldest
+// buffer is always the next one to hand out.
+
+// Slot Struct, a buffer in flight
+typedef struct {
+  uint8_t *buf; // The buffer, NULL to stop the thread popping it
+  uint32_t n;   // Bytes of data in buf
+} Slot;
+
+#define RING_SLOTS (STAGE_BUFFERS + 1) // Every buffer and a NULL one
+
+// Ring Struct, a single producer, single consumer queue of Slots
+typedef struct {
+  Slot slots[RING_SLOTS];
+  uint32_t head; // Next Slot to pop, only moved by the consumer
+  uint32_t tail; // Next Slot to push, only moved by the producer
+  sem_t count;   // Slots pushed but not popped yet
+} Ring;
+
+// Stage Struct
+struct Stage {
+  pthread_t thread; // Our reader or writer thread
+  int fd;           // File read from or written to
+  bool writing;     // Set for a writer Stage
+  bool ended;       // Set once a reader Stage handed out the end of fd
+  bool failed;      // Set if a read failed or a write came up short
+  uint8_t *memory;  // Every buffer, STAGE_SIZE bytes each
+  Ring full;        // Buffers holding data
+  Ring empty;       // Buffers to fill
+  Uring *uring;     // io_uring our IO goes through, or NULL for our thread
+  uint64_t offset;  // File offset of the next read or write submitted
+  uint64_t start[STAGE_BUFFERS]; // File offset of the IO of each buffer
+  uint32_t want[STAGE_BUFFERS];  // Bytes the IO of each buffer moves
+  uint32_t done[STAGE_BUFFERS];  // Bytes it moved so far
+  bool busy[STAGE_BUFFERS];      // Set while its IO is in flight
+  uint32_t next;                 // Buffer to hand out next
+  uint32_t in_flight;            // Buffers with IO in flight
+};
+
+// ring_init : Helper function that sets up an empty Ring. Returns FALSE/0 if
+// error.
+static bool ring_init(Ring *r) {
+  r->head = 0;
+  r->tail = 0;
+  return sem_init(&r->count, 0, 0) == 0;
+}
+
+// ring_push : Helper function that pushes a Slot onto a Ring. A Ring has a
+// Slot for every buffer and a NULL one, so it never fills up. sem_post
+// publishes the Slot to the thread popping it.
+static void ring_push(Ring *r, uint8_t *buf, uint32_t n) {
+  r->slots[r->tail % RING_SLOTS] = (Slot){buf, n};
+  r->tail += 1;
+  sem_post(&r->count);
+  return;
+}
+
+// ring_pop : Helper function that pops the oldest Slot off a Ring, sleeping
+// until there is one. sem_wait makes the pushed Slot visible to us.
+static Slot ring_pop(Ring *r) {
+  while (sem_wait(&r->count) != 0) { // Only fails when interrupted
+  }
+  Slot slot = r->slots[r->head % RING_SLOTS];
+  r->head += 1;
+  return slot;
+}
+
+// stage_reader : Helper function that our reader thread runs. Fills empty
+// buffers from our file until it ends, then hands over an empty one.
+static void *stage_reader(void *arg) {
+  Stage *s = (Stage *)arg;
+  while (1) {
+    Slot slot = ring_pop(&s->empty);
+    if (slot.buf == NULL) { // Stopped early
+      break;
+    }
+    int n = read_bytes(s->fd, slot.buf, STAGE_SIZE);
+    s->failed = n < 0;
+    slot.n = n < 0 ? 0 : n; // A failed read ends our file early
+    ring_push(&s->full, slot.buf, slot.n);
+    if (slot.n == 0) { // The end of our file
+      break;
+    }
+  }
+  return NULL;
+}
+
+// stage_writer : Helper function that our writer thread runs. Writes out
+// full buffers and hands them back until it pops a NULL one.
+static void *stage_writer(void *arg) {
+  Stage *s = (Stage *)arg;
+  while (1) {
+    Slot slot = ring_pop(&s->full);
+    if (slot.buf == NULL) {
+      break;
+    }
+    if (write_bytes(s->fd, slot.buf, slot.n) != (int)slot.n) {
+      s->failed = 1;
+    }
+    ring_push(&s->empty, slot.buf, 0);
+  }
+  return NULL;
+}
+
+// uring_issue : Helper function that submits the rest of the IO of buffer b
+// of a Uring backed Stage. A failed submission counts as a failed IO.
+static void uring_issue(Stage *s, uint32_t b) {
+  uint8_t *buf = s->memory + (uint64_t)b * STAGE_SIZE + s->done[b];
+  if (!uring_submit(s->uring, s->fd, s->writing, b, buf,
+                    s->want[b] - s->done[b], s->start[b] + s->done[b])) {
+    s->failed = 1;
+    s->busy[b] = 0;
+    s->in_flight -= 1;
+  }
+  return;
+}
+
+// uring_start : Helper function that starts reading or writing n bytes of
+// buffer b of a Uring backed Stage, at the next offset of our file
+static void uring_start(Stage *s, uint32_t b, uint32_t n) {
+  s->start[b] = s->offset;
+  s->want[b] = n;
+  s->done[b] = 0;
+  s->busy[b] = 1;
+  s->in_flight += 1;
+  s->offset += n;
+  uring_issue(s, b);
+  return;
+}
+
+// uring_reap : Helper function that waits for the next IO of a Uring backed
+// Stage to finish and resubmits whatever it left undone
+static void uring_reap(Stage *s) {
+  uint32_t b = 0;
+  int32_t ret = 0;
+  if (!uring_wait(s->uring, &b, &ret) || b >= STAGE_BUFFERS) {
+    s->failed = 1; // Lost track of our IO; give up on all of it
+    for (uint32_t i = 0; i < STAGE_BUFFERS; i += 1) {
+      s->busy[i] = 0;
+    }
+    s->in_flight = 0;
+    return;
+  }
+  if (ret == -EINTR || ret == -EAGAIN) { // Try the same IO again
+    uring_issue(s, b);
+    return;
+  }
+  if (ret > 0) {
+    s->done[b] += ret;
+    if (s->writing) { // Count every byte for our stats
+      bytes_written += ret;
+    } else {
+      bytes_read += ret;
+    }
+    if (s->done[b] < s->want[b]) { // Short; go on where it stopped
+      uring_issue(s, b);
+      return;
+    }
+  } else if (ret < 0 || s->writing) { // Failed, or a write that can't go on
+    s->failed = 1;
+  }
+  s->busy[b] = 0; // Done, or a read that hit the end of our file
+  s->in_flight -= 1;
+  return;
+}
+
+// uring_stage : Helper function that moves the IO of a Stage on a regular
+// file onto a Uring. Returns FALSE/0 if io_uring can't be used, in which
+// case the Stage runs its thread instead.
+static bool uring_stage(Stage *s) {
+  struct stat s_buff;
+  off_t offset = lseek(s->fd, 0, SEEK_CUR);
+  if (fstat(s->fd, &s_buff) < 0 || !S_ISREG(s_buff.st_mode) || offset < 0) {
+    return 0; // Pipes have no offsets to read ahead at
+  }
+  s->uring = uring_create(s->memory, STAGE_BUFFERS, STAGE_SIZE);
+  if (s->uring == NULL) {
+    return 0;
+  }
+  s->offset = offset;
+  for (uint32_t b = 0; !s->writing && b < STAGE_BUFFERS; b += 1) {
+    uring_start(s, b, STAGE_SIZE); // Read ahead into every buffer
+  }
+  return 1;
+}
+
+// stage_create : Constructor for a Stage that writes to fd if writing is
+// set, or reads from fd ahead of its caller if not. Returns NULL if error.
+Stage *stage_create(int fd, bool writing) {
+  Stage *s = (Stage *)calloc(1, sizeof(Stage));
+  if (s == NULL) {
+    return NULL;
+  }
+  s->fd = fd;
+  s->writing = writing;
+  s->memory = (uint8_t *)malloc((uint64_t)STAGE_BUFFERS * STAGE_SIZE);
+  if (s->memory != NULL && uring_stage(s)) {
+    return s;
+  }
+  if (s->memory == NULL || !ring_init(&s->full) || !ring_init(&s->empty)) {
+    free(s->memory);
+    free(s);
+    return NULL;
+  }
+  for (uint32_t i = 0; i < STAGE_BUFFERS; i += 1) {
+    ring_push(&s->empty, s->memory + (uint64_t)i * STAGE_SIZE, 0);
+  }
+  if (pthread_create(&s->thread, NULL, writing ? stage_writer : stage_reader,
+                     s) != 0) {
+    sem_destroy(&s->full.count);
+    sem_destroy(&s->empty.count);
+    free(s->memory);
+    free(s);
+    return NULL;
+  }
+  return s;
+}
+
+// stage_get : Function that returns the next buffer of a Stage. From a reader
+// Stage, that is the next buffer read, holding *n bytes, or NULL once the
+// file has ended or a read failed (see stage_finish). From a writer Stage,
+// that is an empty buffer of *n bytes to fill. Waits for the other thread if
+// it has no buffer ready.
+uint8_t *stage_get(Stage *s, uint32_t *n) {
+  if (s->ended) {
+    *n = 0;
+    return NULL;
+  }
+  if (s->uring != NULL) {
+    uint32_t b = s->next;
+    while (s->busy[b]) { // Wait for its read, or for its last write
+      uring_reap(s);
+    }
+    // The end of our file, or a read failed; stage_finish tells them apart
+    if (!s->writing && (s->done[b] == 0 || s->failed)) {
+      s->ended = 1;
+      *n = 0;
+      return NULL;
+    }
+    s->next = (b + 1) % STAGE_BUFFERS;
+    *n = s->writing ? STAGE_SIZE : s->done[b];
+    return s->memory + (uint64_t)b * STAGE_SIZE;
+  }
+  Slot slot = ring_pop(s->writing ? &s->empty : &s->full);
+  if (!s->writing && slot.n == 0) { // Keep the last buffer for stage_finish
+    ring_push(&s->empty, slot.buf, 0);
+    s->ended = 1;
+    *n = 0;
+    return NULL;
+  }
+  *n = s->writing ? STAGE_SIZE : slot.n;
+  return slot.buf;
+}
+
+// stage_put : Function that hands a buffer from stage_get back to a Stage.
+// A writer Stage writes out its first n bytes; a reader Stage fills it again.
+void stage_put(Stage *s, uint8_t *buf, uint32_t n) {
+  if (s->uring != NULL) { // Write it out, or read the next bytes into it
+    uint32_t b = (buf - s->memory) / STAGE_SIZE;
+    if (!s->writing || n > 0) {
+      uring_start(s, b, s->writing ? n : STAGE_SIZE);
+    }
+    return;
+  }
+  if (s->writing) {
+    ring_push(&s->full, buf, n);
+  } else {
+    ring_push(&s->empty, buf, 0);
+  }
+  return;
+}
+
+// stage_finish : Function that stops a Stage and deletes it, once a writer
+// Stage wrote out every buffer it was handed back. A reader Stage may be
+// stopped before the end of its file. Returns FALSE/0 if a read or a write
+// failed.
+bool stage_finish(Stage **s) {
+  Stage *t = *s;
+  if (t->uring != NULL) {
+    while (t->in_flight > 0) { // The kernel may still use our buffers
+      uring_reap(t);
+    }
+    if (t->writing) { // Leave our file where our writes ended, like write()
+      lseek(t->fd, t->offset, SEEK_SET);
+    }
+    uring_delete(&t->uring);
+    bool ok = !t->failed;
+    free(t->memory);
+    free(t);
+    *s = NULL;
+    return ok;
+  }
+  if (t->writing) {
+    ring_push(&t->full, NULL, 0);
+  } else {
+    ring_push(&t->empty, NULL, 0); // In case the reader never hit the end
+  }
+  pthread_join(t->thread, NULL);
+  bool ok = !t->failed;
+  sem_destroy(&t->full.count);
+  sem_destroy(&t->empty.count);
+  free(t->memory);
+  free(t);
+  *s = NULL;
+  return ok;
+}
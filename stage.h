@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct Stage Stage;
+
+Stage *stage_create(int fd, bool writing);
+
+uint8_t *stage_get(Stage *s, uint32_t *n);
+
+void stage_put(Stage *s, uint8_t *buf, uint32_t n);
+
+bool stage_finish(Stage **s);
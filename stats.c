@@ -0,0 +1,199 @@
+// clang-format off
+#include "stats.h"		// Stats header file
+#include "huffman.h"	// Huffman header file
+#include "hist.h"		// Histogram header file
+#include "header.h"		// Headers header file
+#include "io.h"			// IO header file
+#include "defines.h"	// Defines header file
+
+#include <math.h>		// Used for log2
+#include <stdint.h>		// Declares more integer types
+#include <stdio.h>		// Used for input and output for our program
+#include <string.h>		// Used for memset
+#include <sys/resource.h>	// Used for getrusage
+#include <time.h>		// Used for clock_gettime
+// clang-format on
+
+// now : Helper function that returns the time of clock in nanoseconds
+static uint64_t now(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// stats_init : Function that clears our stats
+void stats_init(Stats *s) {
+  memset(s, 0, sizeof(Stats));
+  return;
+}
+
+// stats_phase : Function that ends the phase being timed, if any, and starts
+// timing a phase called name; NULL just ends the current one
+void stats_phase(Stats *s, char *name) {
+  uint64_t wall = now(CLOCK_MONOTONIC);
+  uint64_t cpu = now(CLOCK_PROCESS_CPUTIME_ID); // Counts every thread
+  if (s->phases > 0 && s->wall_start > 0) { // Close the current phase
+    s->wall[s->phases - 1] += wall - s->wall_start;
+    s->cpu[s->phases - 1] += cpu - s->cpu_start;
+    s->wall_start = 0;
+  }
+  if (name != NULL && s->phases < MAX_PHASES) {
+    s->phase[s->phases] = name;
+    s->wall[s->phases] = 0;
+    s->cpu[s->phases] = 0;
+    s->phases += 1;
+    s->wall_start = wall;
+    s->cpu_start = cpu;
+  }
+  return;
+}
+
+// stats_codes : Function that adds symbols counted in hist and coded with
+// the passed code lengths to our stats
+void stats_codes(Stats *s, uint64_t hist[static ALPHABET],
+                 uint8_t lengths[static ALPHABET]) {
+  for (int i = 0; i < ALPHABET; i += 1) {
+    s->hist[i] += hist[i];
+    s->code_bits += hist[i] * lengths[i];
+    if (hist[i] > 0 && lengths[i] > s->max_len) {
+      s->max_len = lengths[i];
+    }
+  }
+  return;
+}
+
+// context_codes : Helper function that adds the symbols of a BLOCK_CONTEXT
+// block, each coded with the table of the byte before it, to our stats
+static void context_codes(Stats *s, BlockHeader *bh, uint8_t *payload,
+                          uint8_t *raw) {
+  uint32_t count = payload[0];
+  uint8_t lengths[CTX_TABLES][ALPHABET];
+  uint32_t pos = 1 + ALPHABET; // Tables follow the table of every context
+  for (uint32_t k = 0; k < count; k += 1) {
+    uint16_t size;
+    memcpy(&size, payload + pos, 2);
+    unpack_lengths(size, payload + pos + 2, lengths[k]);
+    pos += 2 + size;
+  }
+  uint32_t streams = bh->streams ? bh->streams : 1;
+  uint32_t seg = (bh->raw_size + streams - 1) / streams;
+  uint8_t prev = 0;
+  for (uint32_t i = 0; i < bh->raw_size; i += 1) {
+    if (i % seg == 0) { // Every bitstream starts with context 0
+      prev = 0;
+    }
+    uint8_t len = lengths[payload[1 + prev]][raw[i]];
+    s->hist[raw[i]] += 1;
+    s->code_bits += len;
+    s->max_len = len > s->max_len ? len : s->max_len;
+    prev = raw[i];
+  }
+  return;
+}
+
+// stats_block : Function that adds a framed block to our stats, given its
+// header, its payload and its raw_size uncompressed bytes. The block must
+// have decoded, so its tables are sound.
+void stats_block(Stats *s, BlockHeader *bh, uint8_t *payload, uint8_t *raw) {
+  uint64_t hist[ALPHABET] = {0};
+  uint8_t lengths[ALPHABET];
+  if (bh->type == BLOCK_CONTEXT) {
+    context_codes(s, bh, payload, raw);
+  } else if (bh->type == BLOCK_STORED) { // Every byte takes its own 8 bits
+    memset(lengths, 8, ALPHABET);
+    hist_count(hist, raw, bh->raw_size);
+    stats_codes(s, hist, lengths);
+  } else if (unpack_lengths(bh->table_size, payload, lengths)) {
+    hist_count(hist, raw, bh->raw_size);
+    stats_codes(s, hist, lengths);
+  }
+  s->payload_bytes += bh->comp_size - bh->table_size;
+  return;
+}
+
+// stats_print : Function that prints our stats to stderr, as text or as one
+// line of JSON
+void stats_print(Stats *s, bool decoding, uint8_t format) {
+  stats_phase(s, NULL);
+  uint64_t symbols = 0;
+  double entropy = 0; // Shannon entropy in bits per symbol
+  for (int i = 0; i < ALPHABET; i += 1) {
+    symbols += s->hist[i];
+  }
+  for (int i = 0; i < ALPHABET; i += 1) {
+    if (s->hist[i] > 0) {
+      double p = (double)s->hist[i] / symbols;
+      entropy -= p * log2(p);
+    }
+  }
+  double avg_len = symbols ? (double)s->code_bits / symbols : 0;
+  double achieved = s->raw_size ? 8.0 * s->comp_size / s->raw_size : 0;
+  float space_saving =
+      s->raw_size ? 100 * (1 - ((float)s->comp_size / s->raw_size)) : 0;
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  if (format == STATS_JSON) {
+    fprintf(stderr,
+            "{\"program\":\"%s\",\"uncompressed_bytes\":%lu,"
+            "\"compressed_bytes\":%lu,\"space_saving\":%.2f,"
+            "\"header_bytes\":%lu,\"payload_bytes\":%lu,"
+            "\"read_calls\":%lu,\"write_calls\":%lu,\"peak_rss_kb\":%ld,"
+            "\"max_code_length\":%u,\"avg_code_length\":%.4f,"
+            "\"entropy\":%.4f,\"bits_per_symbol\":%.4f,\"files\":%lu,"
+            "\"sampled_bytes\":%lu,\"sample_penalty_bytes\":%ld,"
+            "\"phases\":[",
+            decoding ? "decode" : "encode", s->raw_size, s->comp_size,
+            space_saving, s->comp_size - s->payload_bytes, s->payload_bytes,
+            read_calls, write_calls, usage.ru_maxrss, s->max_len, avg_len,
+            entropy, achieved, s->files, s->sampled, s->penalty);
+    for (uint32_t i = 0; i < s->phases; i += 1) {
+      fprintf(stderr, "%s{\"name\":\"%s\",\"wall_ms\":%.3f,\"cpu_ms\":%.3f}",
+              i ? "," : "", s->phase[i], s->wall[i] / 1e6, s->cpu[i] / 1e6);
+    }
+    fprintf(stderr, "]}\n");
+    return;
+  }
+
+  if (decoding) {
+    fprintf(stderr,
+            "Compressed file size: %lu bytes\n"
+            "Decompressed file size: %lu bytes\n",
+            s->comp_size, s->raw_size);
+  } else {
+    fprintf(stderr,
+            "Uncompressed file size: %lu bytes\n"
+            "Compressed file size: %lu bytes\n",
+            s->raw_size, s->comp_size);
+  }
+  fprintf(stderr,
+          "Space saving: %0.2f%s\n"
+          "Header bytes: %lu\n"
+          "Payload bytes: %lu\n"
+          "Read calls: %lu\n"
+          "Write calls: %lu\n"
+          "Peak RSS: %ld KB\n"
+          "Max code length: %u bits\n"
+          "Average code length: %.4f bits\n"
+          "Entropy: %.4f bits/symbol\n"
+          "Achieved: %.4f bits/symbol\n",
+          space_saving, "%", s->comp_size - s->payload_bytes,
+          s->payload_bytes, read_calls, write_calls, usage.ru_maxrss,
+          s->max_len, avg_len, entropy, achieved);
+  if (s->files > 0) { // Batch mode
+    fprintf(stderr, "Files: %lu\n", s->files);
+  }
+  if (s->sampled > 0) { // Codes built from a sample of infile
+    fprintf(stderr,
+            "Sampled: %lu bytes (%.2f%s)\n"
+            "Sample penalty: %ld bytes (%.4f%s)\n",
+            s->sampled, s->raw_size ? 100.0 * s->sampled / s->raw_size : 0,
+            "%", s->penalty,
+            s->comp_size ? 100.0 * s->penalty / s->comp_size : 0, "%");
+  }
+  for (uint32_t i = 0; i < s->phases; i += 1) {
+    fprintf(stderr, "Phase %s: %.3f ms wall, %.3f ms CPU\n", s->phase[i],
+            s->wall[i] / 1e6, s->cpu[i] / 1e6);
+  }
+  return;
+}
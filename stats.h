@@ -0,0 +1,35 @@
+#pragma once
+
+#include "defines.h"
+#include "header.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    char *phase[MAX_PHASES];   // Names of the phases timed
+    uint64_t wall[MAX_PHASES]; // Wall time of each phase in ns
+    uint64_t cpu[MAX_PHASES];  // CPU time of each phase in ns, all threads
+    uint32_t phases;           // Number of phases timed
+    uint64_t wall_start;       // Wall time the current phase started at
+    uint64_t cpu_start;        // CPU time the current phase started at
+    uint64_t raw_size;         // Uncompressed bytes
+    uint64_t comp_size;        // Compressed bytes
+    uint64_t payload_bytes;    // Compressed bytes that are bitstream
+    uint64_t hist[ALPHABET];   // Histogram of the symbols coded
+    uint64_t code_bits;        // Bits of codes, not counting padding
+    uint32_t max_len;          // Longest code used
+    uint64_t files;            // Files coded in batch mode
+    uint64_t sampled;          // Bytes sampled codes were built from, or 0
+    int64_t penalty;           // Bytes sampled codes cost over full ones
+} Stats;
+
+void stats_init(Stats *s);
+
+void stats_phase(Stats *s, char *name);
+
+void stats_codes(Stats *s, uint64_t hist[static ALPHABET],
+                 uint8_t lengths[static ALPHABET]);
+
+void stats_block(Stats *s, BlockHeader *bh, uint8_t *payload, uint8_t *raw);
+
+void stats_print(Stats *s, bool decoding, uint8_t format);
@@ -0,0 +1,334 @@
+// clang-format off
+#include "table.h"		// Decode Table header file
+#include "huffman.h"	// Huffman header file
+#include "header.h"		// Headers header file
+#include "code.h"		// Code header file
+#include "io.h"			// IO header file
+#include "defines.h"	// Defines header file
+
+#include <stdint.h>		// Declares more integer types
+#include <stdio.h>		// Used for input and output for our program
+#include <stdlib.h>		// Used for macros and functions used in our program
+#include <string.h>		// Used for memset
+// clang-format on
+
+// A Decode Table maps the next few bits of the bitstream straight to a symbol
+// and its code length, instead of walking the Huffman tree one bit at a time.
+// The root table is indexed by the next root_bits bits (first bit in bit 0).
+// Codes longer than that land on a link entry that points to a smaller
+// sub-table indexed by the bits that follow.
+
+// Entry Struct, one slot of the root table or of a sub-table
+typedef struct {
+  uint16_t value; // Symbol for a leaf entry, sub-table offset for a link entry
+  uint8_t bits;   // Code bits consumed by a leaf entry or index width of the
+                  // sub-table for a link entry; 0 marks an unused entry
+  uint8_t link;   // 1 if this entry points to a sub-table
+} Entry;
+
+// Decode Table Struct
+struct DecodeTable {
+  Entry *entries;     // Root table followed by every sub-table
+  uint32_t size;      // Number of entries in use
+  uint32_t capacity;  // Number of entries allocated
+  uint32_t root_bits; // Index width of the root table
+};
+
+// code_bits : Helper function that returns nbits bits of Code c starting at
+// index offset, with the first bit placed in bit 0
+static uint32_t code_bits(Code *c, uint32_t offset, uint32_t nbits) {
+  uint32_t ret = 0;
+  for (uint32_t i = 0; i < nbits; i += 1) {
+    ret |= (uint32_t)code_get_bit(c, offset + i) << i;
+  }
+  return ret;
+}
+
+// dt_alloc : Helper function that reserves 2^width zeroed entries at the end
+// of our table. Returns the offset of the first entry or -1 if error.
+static int64_t dt_alloc(DecodeTable *t, uint32_t width) {
+  uint32_t n = 1U << width;
+  if (t->size + n > t->capacity) { // Grow our entries if they do not fit
+    uint32_t capacity = t->capacity * 2;
+    while (capacity < t->size + n) {
+      capacity *= 2;
+    }
+    Entry *entries = (Entry *)realloc(t->entries, capacity * sizeof(Entry));
+    if (entries == NULL) {
+      return -1;
+    }
+    t->entries = entries;
+    t->capacity = capacity;
+  }
+  memset(t->entries + t->size, 0, n * sizeof(Entry)); // Mark them unused
+  t->size += n;
+  return t->size - n;
+}
+
+// dt_fill : Helper function that fills the table of index width width at
+// offset base with the nsyms symbols in syms. Every one of those codes shares
+// the same first offset bits. Returns FALSE/0 if error.
+static bool dt_fill(DecodeTable *t, uint32_t base, uint32_t width,
+                    uint32_t offset, Code codes[static ALPHABET],
+                    uint16_t *syms, uint32_t nsyms) {
+  uint16_t group[ALPHABET]; // Symbols that continue into the same sub-table
+  for (uint32_t i = 0; i < nsyms; i += 1) {
+    Code *c = &codes[syms[i]];
+    uint32_t rem = code_size(c) - offset; // Bits left to decode
+    if (rem <= width) { // Leaf: repeat it for every value of the unused bits
+      uint32_t idx = code_bits(c, offset, rem);
+      for (uint32_t j = idx; j < (1U << width); j += 1U << rem) {
+        t->entries[base + j].value = syms[i];
+        t->entries[base + j].bits = rem;
+        t->entries[base + j].link = 0;
+      }
+      continue;
+    }
+    uint32_t key = code_bits(c, offset, width);
+    if (t->entries[base + key].link) { // Sub-table already built
+      continue;
+    }
+    // Gather every symbol with this prefix and size the sub-table for them
+    uint32_t ngroup = 0;
+    uint32_t max_rem = 0;
+    for (uint32_t k = i; k < nsyms; k += 1) {
+      Code *d = &codes[syms[k]];
+      if (code_size(d) - offset > width &&
+          code_bits(d, offset, width) == key) {
+        group[ngroup] = syms[k];
+        ngroup += 1;
+        if (code_size(d) - offset - width > max_rem) {
+          max_rem = code_size(d) - offset - width;
+        }
+      }
+    }
+    uint32_t sub_bits = max_rem < DT_SUB_BITS ? max_rem : DT_SUB_BITS;
+    int64_t sub = dt_alloc(t, sub_bits);
+    if (sub < 0) {
+      return 0;
+    }
+    t->entries[base + key].value = sub;
+    t->entries[base + key].bits = sub_bits;
+    t->entries[base + key].link = 1;
+    if (!dt_fill(t, sub, sub_bits, offset + width, codes, group, ngroup)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// dt_create : Constructor for a Decode Table built from a filled Code table.
+// Symbols with an empty Code are not decodable. Returns NULL if error.
+DecodeTable *dt_create(Code codes[static ALPHABET]) {
+  DecodeTable *t = (DecodeTable *)malloc(sizeof(DecodeTable));
+  if (t != NULL) { // If malloc worked for our Decode Table
+    uint16_t syms[ALPHABET]; // Symbols that have a Code
+    uint32_t nsyms = 0;
+    uint32_t max_len = 0;
+    for (uint32_t i = 0; i < ALPHABET; i += 1) {
+      if (!code_empty(&codes[i])) {
+        syms[nsyms] = i;
+        nsyms += 1;
+        if (code_size(&codes[i]) > max_len) {
+          max_len = code_size(&codes[i]);
+        }
+      }
+    }
+    // No need for a root table wider than our longest code, and codes of up
+    // to DT_FLAT_BITS bits are decoded with a single lookup
+    t->root_bits = max_len <= DT_FLAT_BITS ? max_len : DT_ROOT_BITS;
+    t->capacity = 1U << t->root_bits;
+    t->size = 0;
+    t->entries = (Entry *)malloc(t->capacity * sizeof(Entry));
+    if (t->entries == NULL || dt_alloc(t, t->root_bits) < 0 ||
+        !dt_fill(t, 0, t->root_bits, 0, codes, syms, nsyms)) {
+      dt_delete(&t);
+    }
+  }
+  return t; // Returns Null if not created correctly, else returns the table
+}
+
+// dt_read : Constructor for the Decode Table of a whole file, built from
+// the dumped tree or packed code lengths that follow its Header h in r. The
+// code lengths are also stored in lengths (ALPHABET of them) unless it is
+// NULL. Returns NULL if they are malformed or if error.
+DecodeTable *dt_read(Header *h, BitReader *r, uint8_t *lengths) {
+  uint8_t table_lengths[ALPHABET];
+  lengths = lengths != NULL ? lengths : table_lengths;
+  Code codes[ALPHABET];
+  for (int i = 0; i < ALPHABET; i += 1) {
+    codes[i] = code_init(); // Initialize our table with codes at every index
+  }
+  if (h->magic == MAGIC_CANON) { // Canonical codes from their packed lengths
+    uint8_t packed[MAX_LENS_SIZE];
+    if (h->tree_size > MAX_LENS_SIZE ||
+        !unpack_lengths(br_read_bytes(r, packed, h->tree_size), packed,
+                        lengths) ||
+        !canonical_codes(lengths, codes)) {
+      return NULL;
+    }
+  } else { // Rebuilding our huffman tree
+    uint8_t tree[MAX_TREE_SIZE];
+    Tree huff_tree;
+    if (h->magic != MAGIC || h->tree_size > MAX_TREE_SIZE ||
+        !rebuild_tree(br_read_bytes(r, tree, h->tree_size), tree,
+                      &huff_tree)) {
+      return NULL;
+    }
+    build_codes(&huff_tree, codes);
+    build_lengths(&huff_tree, lengths);
+  }
+  return dt_create(codes);
+}
+
+// dt_delete : Function that deletes our Decode Table
+void dt_delete(DecodeTable **t) {
+  free((*t)->entries); // Frees our entries
+  (*t)->entries = NULL;
+  free(*t); // Frees our Decode Table
+  (*t) = NULL;
+  return;
+}
+
+// dt_decode : Function that decodes the next symbol from a Bit Reader.
+// Returns FALSE/0 if the reader ran out of bits or the bits do not form a
+// code.
+bool dt_decode(DecodeTable *t, BitReader *r, uint8_t *symbol) {
+  uint32_t width = t->root_bits;
+  Entry e = t->entries[br_peek(r, width)];
+  while (e.link) { // Long code, move on to the sub-table
+    br_skip(r, width);
+    width = e.bits;
+    e = t->entries[e.value + br_peek(r, width)];
+  }
+  if (e.bits == 0) { // Not a valid code
+    return 0;
+  }
+  *symbol = e.value;
+  return br_skip(r, e.bits); // Consume exactly the bits of this code
+}
+
+// dt_decode_bytes : Function that decodes up to n symbols from a Bit Reader
+// into dst. Returns the number of symbols decoded, which is less than n only
+// if the reader ran out of bits or hit an invalid code.
+uint32_t dt_decode_bytes(DecodeTable *t, BitReader *r, uint8_t *dst,
+                         uint32_t n) {
+  Entry *entries = t->entries;
+  uint32_t root_bits = t->root_bits;
+  uint32_t root_mask = (1U << root_bits) - 1;
+  for (uint32_t i = 0; i < n; i += 1) {
+    if (r->bits < root_bits) { // Only refill when a lookup could run short
+      br_fill(r);
+    }
+    Entry e = entries[r->acc & root_mask];
+    if (e.link) { // Rare long code, take the general path
+      if (!dt_decode(t, r, &dst[i])) {
+        return i;
+      }
+      continue;
+    }
+    if (e.bits == 0 || e.bits > r->bits) { // Invalid code or out of bits
+      return i;
+    }
+    dst[i] = e.value;
+    r->acc >>= e.bits;
+    r->bits -= e.bits;
+  }
+  return n;
+}
+
+// dt_decode_streams : Function that decodes streams bitstreams, n[s]
+// symbols from r[s] into dst[s] for each stream s, advancing every stream by
+// one symbol per pass. The lookups of separate streams do not depend on each
+// other, so the CPU overlaps them instead of waiting on one code length at a
+// time. Returns FALSE/0 if a stream ran out of bits or hit an invalid code.
+bool dt_decode_streams(DecodeTable *t, BitReader *r, uint8_t **dst,
+                       uint32_t *n, uint32_t streams) {
+  Entry *entries = t->entries;
+  uint32_t root_bits = t->root_bits;
+  uint32_t root_mask = (1U << root_bits) - 1;
+  uint32_t common = n[0]; // Symbols every stream has
+  for (uint32_t s = 1; s < streams; s += 1) {
+    common = n[s] < common ? n[s] : common;
+  }
+  for (uint32_t i = 0; i < common; i += 1) {
+    for (uint32_t s = 0; s < streams; s += 1) {
+      if (r[s].bits < root_bits) { // Only refill when a lookup could run short
+        br_fill(&r[s]);
+      }
+      Entry e = entries[r[s].acc & root_mask];
+      if (e.link) { // Rare long code, take the general path
+        if (!dt_decode(t, &r[s], &dst[s][i])) {
+          return 0;
+        }
+        continue;
+      }
+      if (e.bits == 0 || e.bits > r[s].bits) { // Invalid code or out of bits
+        return 0;
+      }
+      dst[s][i] = e.value;
+      r[s].acc >>= e.bits;
+      r[s].bits -= e.bits;
+    }
+  }
+  for (uint32_t s = 0; s < streams; s += 1) { // Streams longer than the rest
+    if (dt_decode_bytes(t, &r[s], dst[s] + common, n[s] - common) !=
+        n[s] - common) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// dt_decode_contexts : Function that decodes streams bitstreams like
+// dt_decode_streams, but decodes each symbol with the table of its context,
+// ctx[prev] for the symbol prev before it in its stream; the first symbol
+// of every stream has context 0. Returns FALSE/0 if a stream ran out of
+// bits or hit an invalid code.
+bool dt_decode_contexts(DecodeTable *ctx[static ALPHABET], BitReader *r,
+                        uint8_t **dst, uint32_t *n, uint32_t streams) {
+  uint8_t prev[MAX_STREAMS] = {0}; // Context of every stream
+  uint32_t longest = 0;
+  for (uint32_t s = 0; s < streams; s += 1) {
+    longest = n[s] > longest ? n[s] : longest;
+  }
+  for (uint32_t i = 0; i < longest; i += 1) {
+    for (uint32_t s = 0; s < streams; s += 1) {
+      if (i >= n[s]) { // Only the last stream can run out early
+        continue;
+      }
+      DecodeTable *t = ctx[prev[s]];
+      if (r[s].bits < t->root_bits) {
+        br_fill(&r[s]);
+      }
+      Entry e = t->entries[r[s].acc & ((1U << t->root_bits) - 1)];
+      if (e.link) { // Rare long code, take the general path
+        if (!dt_decode(t, &r[s], &dst[s][i])) {
+          return 0;
+        }
+      } else if (e.bits == 0 || e.bits > r[s].bits) { // Invalid or out of bits
+        return 0;
+      } else {
+        dst[s][i] = e.value;
+        r[s].acc >>= e.bits;
+        r[s].bits -= e.bits;
+      }
+      prev[s] = dst[s][i];
+    }
+  }
+  return 1;
+}
+
+// dt_print : Function that prints the entries of our Decode Table
+void dt_print(DecodeTable *t) {
+  for (uint32_t i = 0; i < t->size; i += 1) {
+    if (t->entries[i].link) {
+      printf("Index: %u, Link: %u (%u bits)\n", i, t->entries[i].value,
+             t->entries[i].bits);
+    } else if (t->entries[i].bits) {
+      printf("Index: %u, Symbol: %u (%u bits)\n", i, t->entries[i].value,
+             t->entries[i].bits);
+    }
+  }
+  return;
+}
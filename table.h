@@ -0,0 +1,29 @@
+#pragma once
+
+#include "code.h"
+#include "defines.h"
+#include "header.h"
+#include "io.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct DecodeTable DecodeTable;
+
+DecodeTable *dt_create(Code codes[static ALPHABET]);
+
+DecodeTable *dt_read(Header *h, BitReader *r, uint8_t *lengths);
+
+void dt_delete(DecodeTable **t);
+
+bool dt_decode(DecodeTable *t, BitReader *r, uint8_t *symbol);
+
+uint32_t dt_decode_bytes(DecodeTable *t, BitReader *r, uint8_t *dst,
+                         uint32_t n);
+
+bool dt_decode_streams(DecodeTable *t, BitReader *r, uint8_t **dst,
+                       uint32_t *n, uint32_t streams);
+
+bool dt_decode_contexts(DecodeTable *ctx[static ALPHABET], BitReader *r,
+                        uint8_t **dst, uint32_t *n, uint32_t streams);
+
+void dt_print(DecodeTable *t);
@@ -0,0 +1,131 @@
+// clang-format off
+#include "io.h"		      // IO Header File
+#include "dict.h"	      // Dictionary Header File
+#include "hist.h"	      // Histogram Header File
+#include "defines.h"	  // Defines Header File
+
+#include <fcntl.h>	    // Used for file functions
+#include <inttypes.h>	  // Used for printing 64 bit sizes
+#include <sys/stat.h>	  // Used for file permission bits
+#include <stdint.h>	    // Declares more integer types
+#include <stdio.h>	    // Used for input and output for our program
+#include <stdlib.h>	    // Used for macros and functions used in our program
+#include <unistd.h>	    // Used for types and functions for our program
+// clang-format on
+
+#define OPTIONS "hl:o:v" // Valid User commands
+
+// help : Help message that displayes program synopsis and usage; prints to
+// stderr
+void help(void) { // Help message that displayes program synopsis and usage
+  fprintf(stderr, "SYNOPSIS\n"
+                  "  A Huffman dictionary trainer.\n"
+                  "  Builds shared codes from a sample corpus for encode -D\n"
+                  "  and decode -D.\n"
+                  "\n"
+                  "USAGE\n"
+                  "  ./train [-h] [-v] [-l bits] [-o dict] [file ...]\n"
+                  "\n"
+                  "OPTIONS\n"
+                  "  -h             Program usage and help.\n"
+                  "  -v             Print the dictionary id and its size.\n"
+                  "  -l bits        Limit codes to at most bits bits (8-32,\n"
+                  "                 default 12).\n"
+                  "  -o dict        Output dictionary file.\n"
+                  "  file ...       Sample files; stdin if none.\n");
+  return;
+}
+
+// count_file : Function that adds every byte of infile to hist. Returns the
+// number of bytes counted.
+uint64_t count_file(int infile, uint64_t hist[static ALPHABET]) {
+  uint64_t size = 0;
+  uint8_t *map = map_input(infile, &size);
+  if (map != NULL) { // Regular files are counted straight out of a mapping
+    hist_count(hist, map, size);
+    unmap_input(map, size);
+    return size;
+  }
+  uint8_t buff[IO_BLOCK]; // Buffer for reading infile a chunk at a time
+  int n = 0;              // Number of bytes in buff
+  while ((n = read_bytes(infile, buff, IO_BLOCK)) > 0) {
+    hist_count(hist, buff, n);
+    size += n;
+  }
+  return size;
+}
+
+// main : main function for train
+int main(int argc, char **argv) {
+  int opt = 0;                 // Used to store the current user input
+  int outfile = STDOUT_FILENO; // Used to store the dictionary file
+  bool verbose = 0;            // Used to indicate if the user wants stats
+  uint32_t limit = DICT_LIMIT; // Longest code length allowed
+
+  while ((opt = getopt(argc, argv, OPTIONS)) !=
+         -1) {     // Go in a loop to handle users input(s)
+    switch (opt) { // Use switch to handle users input
+    case 'o':      // User wants to specify the dictionary file
+      // Opening output file, will create if does not exist
+      outfile = open(optarg, O_CREAT | O_WRONLY | O_TRUNC, S_IRUSR | S_IWUSR);
+      break; // Break; ensures we only go through this case
+
+    case 'v': // User wants to print out the dictionary stats
+      verbose = 1;
+      break; // Break; ensures we only go through this case
+
+    case 'l': // User wants to limit the length of our codes
+      limit = strtoul(optarg, NULL, 10);
+      if (limit < 8 || limit > MAX_LIMIT) { // 8 bits always fit 256 symbols
+        fprintf(stderr, "train: Code length limit must be 8 to %d bits\n",
+                MAX_LIMIT);
+        help();             // Print the programs synopsis and usage
+        exit(EXIT_FAILURE); // Exit with non-zero exit code
+      }
+      break; // Break; ensures we only go through this case
+
+    case 'h': // User wants to see the programs synopsis and usage
+      help();
+      exit(EXIT_SUCCESS); // Exits indicating a successful termination
+      break;              // Break; ensures we only go through this case
+
+    default: // User had invalid command
+      help();
+      exit(EXIT_FAILURE); // Exit with non-zero exit code
+      break;              // Break; ensures we only go through this case
+    }
+  }
+
+  // Counting every byte of the corpus
+  uint64_t hist[ALPHABET] = {0};
+  uint64_t corpus = 0; // Number of bytes counted
+  if (optind == argc) {
+    corpus = count_file(STDIN_FILENO, hist);
+  }
+  for (int i = optind; i < argc; i += 1) {
+    int infile = open(argv[i], O_RDONLY);
+    if (infile < 0) {
+      fprintf(stderr, "train: Couldn't open %s : No such file or directory\n",
+              argv[i]);
+      exit(EXIT_FAILURE); // Exit with non-zero exit code
+    }
+    corpus += count_file(infile, hist);
+    close(infile);
+  }
+
+  // Training and saving our dictionary
+  Dictionary dict;
+  if (!dict_train(hist, limit, &dict) || !dict_save(outfile, &dict)) {
+    fprintf(stderr, "train: Couldn't write dictionary\n");
+    exit(EXIT_FAILURE); // Exit with non-zero exit code
+  }
+  if (verbose) {
+    fprintf(stderr,
+            "Corpus size: %" PRIu64 " bytes\n"
+            "Dictionary id: %08" PRIx32 "\n"
+            "Dictionary size: %" PRIu64 " bytes\n",
+            corpus, dict.id, (uint64_t)bytes_written);
+  }
+  close(outfile);
+  exit(EXIT_SUCCESS); // Exits indicating a successful termination
+}
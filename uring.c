@@ -0,0 +1,182 @@
+// clang-format off
+#include "uring.h"		// Uring header file
+#include "io.h"			// IO header file
+
+#include <errno.h>		// Used for checking interrupted system calls
+#include <linux/io_uring.h>	// Used for the io_uring interface
+#include <stdatomic.h>	// Used for the ring indices shared with the kernel
+#include <stdint.h>		// Declares more integer types
+#include <stdlib.h>		// Used for macros and functions used in our program
+#include <string.h>		// Used for memset
+#include <sys/mman.h>	// Used for mapping the rings
+#include <sys/syscall.h>	// Used for the io_uring system calls
+#include <sys/uio.h>	// Used for registering buffers
+#include <unistd.h>		// Used for types and functions for our program
+// clang-format on
+
+// A Uring is an io_uring, a pair of rings shared with the kernel: we push
+// reads and writes onto the submission ring and the kernel pushes their
+// results onto the completion ring, so many can be in flight at once from a
+// single thread. Its buffers are registered with the kernel up front, which
+// saves mapping them on every read or write. There is no liburing here; the
+// rings are driven through the raw system calls. Each read or write carries
+// the index of its buffer, which comes back with its result.
+
+// Uring Struct
+struct Uring {
+  int fd;                        // The io_uring
+  uint8_t *memory;               // Registered buffers, size bytes each
+  uint32_t size;                 // Bytes per buffer
+  void *sq_map;                  // Mapping of the submission ring
+  size_t sq_len;                 // Size of sq_map
+  void *cq_map;                  // Mapping of the completion ring, may be
+  size_t cq_len;                 // sq_map
+  struct io_uring_sqe *sqes;     // Submission entries
+  size_t sqes_len;               // Size of sqes
+  _Atomic uint32_t *sq_tail;     // Next submission, moved by us
+  uint32_t sq_mask;              // Index mask of the submission ring
+  uint32_t *sq_array;            // Submission entry of every ring slot
+  _Atomic uint32_t *cq_head;     // Next completion, moved by us
+  _Atomic uint32_t *cq_tail;     // Last completion, moved by the kernel
+  uint32_t cq_mask;              // Index mask of the completion ring
+  struct io_uring_cqe *cqes;     // Completion entries
+};
+
+// uring_create : Constructor for a Uring with room for an operation on
+// every one of buffers buffers of size bytes at memory, which it registers.
+// Returns NULL if io_uring is unavailable or if error, in which case the
+// caller falls back to plain system calls.
+Uring *uring_create(uint8_t *memory, uint32_t buffers, uint32_t size) {
+  Uring *u = (Uring *)calloc(1, sizeof(Uring));
+  if (u == NULL) {
+    return NULL;
+  }
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  u->fd = syscall(__NR_io_uring_setup, buffers, &p);
+  if (u->fd < 0) { // Old kernel, or io_uring is turned off
+    free(u);
+    return NULL;
+  }
+  u->memory = memory;
+  u->size = size;
+  u->sq_len = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+  u->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) { // Both rings in one mapping
+    u->sq_len = u->sq_len > u->cq_len ? u->sq_len : u->cq_len;
+  }
+  u->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+  u->sq_map = mmap(NULL, u->sq_len, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+  u->cq_map = u->sq_map;
+  if (u->sq_map != MAP_FAILED && !(p.features & IORING_FEAT_SINGLE_MMAP)) {
+    u->cq_map = mmap(NULL, u->cq_len, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+  }
+  u->sqes = (struct io_uring_sqe *)mmap(NULL, u->sqes_len,
+                                        PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_POPULATE, u->fd,
+                                        IORING_OFF_SQES);
+  struct iovec iov[buffers];
+  for (uint32_t i = 0; i < buffers; i += 1) {
+    iov[i].iov_base = memory + (uint64_t)i * size;
+    iov[i].iov_len = size;
+  }
+  if (u->sq_map == MAP_FAILED || u->cq_map == MAP_FAILED ||
+      u->sqes == MAP_FAILED ||
+      syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_BUFFERS, iov,
+              buffers) < 0) { // Out of locked memory, most likely
+    if (u->sq_map == MAP_FAILED) { // Nothing after it was mapped
+      u->cq_map = MAP_FAILED;
+    }
+    if (u->sqes != MAP_FAILED) {
+      munmap(u->sqes, u->sqes_len);
+    }
+    if (u->cq_map != MAP_FAILED && u->cq_map != u->sq_map) {
+      munmap(u->cq_map, u->cq_len);
+    }
+    if (u->sq_map != MAP_FAILED) {
+      munmap(u->sq_map, u->sq_len);
+    }
+    close(u->fd);
+    free(u);
+    return NULL;
+  }
+  uint8_t *sq = (uint8_t *)u->sq_map;
+  uint8_t *cq = (uint8_t *)u->cq_map;
+  u->sq_tail = (_Atomic uint32_t *)(sq + p.sq_off.tail);
+  u->sq_mask = *(uint32_t *)(sq + p.sq_off.ring_mask);
+  u->sq_array = (uint32_t *)(sq + p.sq_off.array);
+  u->cq_head = (_Atomic uint32_t *)(cq + p.cq_off.head);
+  u->cq_tail = (_Atomic uint32_t *)(cq + p.cq_off.tail);
+  u->cq_mask = *(uint32_t *)(cq + p.cq_off.ring_mask);
+  u->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+  return u;
+}
+
+// uring_delete : Function that deletes a Uring. Every operation submitted
+// must have been waited for.
+void uring_delete(Uring **u) {
+  munmap((*u)->sqes, (*u)->sqes_len);
+  if ((*u)->cq_map != (*u)->sq_map) {
+    munmap((*u)->cq_map, (*u)->cq_len);
+  }
+  munmap((*u)->sq_map, (*u)->sq_len);
+  close((*u)->fd); // Also unregisters our buffers
+  free(*u);
+  *u = NULL;
+  return;
+}
+
+// uring_submit : Function that starts reading n bytes of fd at offset into
+// buf, or writing them from buf if writing is set, where buf lies in
+// registered buffer buffer. Returns FALSE/0 if error.
+bool uring_submit(Uring *u, int fd, bool writing, uint32_t buffer,
+                  uint8_t *buf, uint32_t n, uint64_t offset) {
+  uint32_t tail = atomic_load_explicit(u->sq_tail, memory_order_relaxed);
+  uint32_t index = tail & u->sq_mask;
+  struct io_uring_sqe *sqe = &u->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = writing ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t)(uintptr_t)buf;
+  sqe->len = n;
+  sqe->off = offset;
+  sqe->buf_index = buffer;
+  sqe->user_data = buffer;
+  u->sq_array[index] = index;
+  atomic_store_explicit(u->sq_tail, tail + 1, memory_order_release);
+  int ret = 0;
+  do {
+    ret = syscall(__NR_io_uring_enter, u->fd, 1, 0, 0, NULL, 0);
+    if (writing) { // Count every system call for our stats
+      write_calls += 1;
+    } else {
+      read_calls += 1;
+    }
+  } while (ret < 0 && errno == EINTR);
+  if (ret != 1) { // The kernel never took it, so take it back
+    atomic_store_explicit(u->sq_tail, tail, memory_order_release);
+    return 0;
+  }
+  return 1;
+}
+
+// uring_wait : Function that waits for the next read or write of a Uring to
+// finish, and stores its buffer in *buffer and its result in *result: the
+// bytes moved, or a negative errno. Returns FALSE/0 if error.
+bool uring_wait(Uring *u, uint32_t *buffer, int32_t *result) {
+  uint32_t head = atomic_load_explicit(u->cq_head, memory_order_relaxed);
+  while (head == atomic_load_explicit(u->cq_tail, memory_order_acquire)) {
+    if (syscall(__NR_io_uring_enter, u->fd, 0, 1, IORING_ENTER_GETEVENTS,
+                NULL, 0) < 0 &&
+        errno != EINTR) {
+      return 0;
+    }
+  }
+  struct io_uring_cqe *cqe = &u->cqes[head & u->cq_mask];
+  *buffer = cqe->user_data;
+  *result = cqe->res;
+  atomic_store_explicit(u->cq_head, head + 1, memory_order_release);
+  return 1;
+}
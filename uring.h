@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct Uring Uring;
+
+Uring *uring_create(uint8_t *memory, uint32_t buffers, uint32_t size);
+
+void uring_delete(Uring **u);
+
+bool uring_submit(Uring *u, int fd, bool writing, uint32_t buffer,
+                  uint8_t *buf, uint32_t n, uint64_t offset);
+
+bool uring_wait(Uring *u, uint32_t *buffer, int32_t *result);